@@ -0,0 +1,372 @@
+#include "carve_session.h"
+#include "window_energy.h"
+
+#include <algorithm>
+#include <cstddef>
+
+CarveSession::CarveSession(
+    const QImage &image,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    bool horizontal
+) : kernelX(kernelX), kernelY(kernelY), window(window), horizontal(horizontal), pixels(image) {
+    // 窗口能量与 seam 的方向无关，只有卷积核需要按方向转置
+    if (horizontal && kernelX != nullptr && kernelY != nullptr && window == WindowEnergy::None) {
+        horizontal_kernels(*kernelX, *kernelY, transposedX, transposedY, this->kernelX, this->kernelY);
+    }
+
+    pixels.gray(gray);
+    // 前向能量在 DP 中由灰度图直接计算，不保留能量图
+    if (!forward()) {
+        calc_energy_conv(gray, energy, *this->kernelX, *this->kernelY, window);
+    }
+}
+
+void CarveSession::set_pyramid(int levels, int band) {
+    energy_pyramid = SeamPyramid<int>(levels, band);
+    gray_pyramid = SeamPyramid<uchar>(levels, band);
+}
+
+void CarveSession::set_mask(const Plane<uchar> &mask, int margin) {
+    this->mask = mask;
+    mask_margin = qMax(0, margin);
+    has_protect = false;
+    remove_count = 0;
+    remove_lo = carve_size();
+    remove_hi = -1;
+    for (int y = 0; y < mask.height(); y++) {
+        const uchar *m = mask.row(y);
+        for (int x = 0; x < mask.width(); x++) {
+            has_protect |= m[x] == MaskProtect;
+            if (m[x] == MaskRemove) {
+                remove_count++;
+                remove_lo = qMin(remove_lo, horizontal ? y : x);
+                remove_hi = qMax(remove_hi, horizontal ? y : x);
+            }
+        }
+    }
+}
+
+long long CarveSession::remove_left() const {
+    return remove_count;
+}
+
+const Plane<uchar> &CarveSession::current_mask() const {
+    return mask;
+}
+
+bool CarveSession::carve() {
+    SEAM_CARVER_TRACE_PIXELS("seam", (long long) pixels.width() * pixels.height());
+    if (carve_size() <= 1) {
+        return false;
+    }
+    // 完整的动态规划复用 scratch 与 current_seam，逐条移除时不分配内存
+    if (mask_active()) {
+        if (!find_masked_seam()) {
+            return false;
+        }
+    } else if (energy_pyramid.levels() > 0) {
+        current_seam =
+            forward() ? gray_pyramid.find_seam(gray, horizontal) : energy_pyramid.find_seam(energy, horizontal);
+    } else if (forward()) {
+        find_seam_forward(gray, scratch, current_seam, horizontal);
+    } else {
+        find_seam(energy, scratch, current_seam, horizontal);
+    }
+    removed += seam_cost(current_seam);
+    if (recording) {
+        record(current_seam, seam_count);
+    }
+    const bool has_mask = !mask.empty();
+    if (has_mask) {
+        for (int i = 0; i < (int) current_seam.size(); i++) {
+            remove_count -= (horizontal ? mask.at(i, current_seam[i]) : mask.at(current_seam[i], i)) == MaskRemove;
+        }
+    }
+    if (horizontal) {
+        pixels.remove_seam(current_seam, true);
+        remove_horizontal_seam(gray, current_seam);
+        if (!forward()) {
+            remove_horizontal_seam(energy, current_seam);
+        }
+        if (recording) {
+            remove_horizontal_seam(origin, current_seam);
+        }
+        if (has_mask) {
+            remove_horizontal_seam(mask, current_seam);
+        }
+    } else {
+        pixels.remove_seam(current_seam, false);
+        remove_seam(gray, current_seam);
+        if (!forward()) {
+            remove_seam(energy, current_seam);
+        }
+        if (recording) {
+            remove_seam(origin, current_seam);
+        }
+        if (has_mask) {
+            remove_seam(mask, current_seam);
+        }
+    }
+    update_energy(current_seam, 1);
+    if (has_mask) {
+        update_remove_range();
+    }
+    if (forward()) {
+        gray_pyramid.seam_removed(gray, current_seam, horizontal);
+    } else {
+        energy_pyramid.seam_removed(energy, current_seam, horizontal);
+    }
+    seam_count++;
+    return true;
+}
+
+int CarveSession::carve_multiple(int k) {
+    SEAM_CARVER_TRACE_PIXELS("seams", (long long) pixels.width() * pixels.height());
+    k = qMin(k, carve_size() - 1);
+    if (k <= 0) {
+        return 0;
+    }
+    // 保护或待移除区域仍在时逐条移除；掩码只剩普通像素时与图像一起批量移除，保持对齐
+    if (k == 1 || mask_active()) {
+        int done = 0;
+        while (done < k && carve()) {
+            done++;
+        }
+        return done;
+    }
+
+    const std::vector<std::vector<int>> seams =
+        forward() ? find_seams_forward(gray, k, horizontal) : find_seams(energy, k, horizontal);
+    k = seams.size();
+    for (int j = 0; j < k; j++) {
+        removed += seam_cost(seams[j]);
+        if (recording) {
+            record(seams[j], seam_count + j);
+        }
+    }
+    const int lines = seams[0].size();
+    std::vector<int> positions((std::size_t) lines * k);
+    for (int i = 0; i < lines; i++) {
+        int *p = positions.data() + (std::size_t) i * k;
+        for (int j = 0; j < k; j++) {
+            p[j] = seams[j][i];
+        }
+        std::sort(p, p + k);
+    }
+    if (horizontal) {
+        pixels.remove_seams(positions, k, true);
+        remove_horizontal_seams(gray, positions, k);
+        if (!forward()) {
+            remove_horizontal_seams(energy, positions, k);
+        }
+        if (recording) {
+            remove_horizontal_seams(origin, positions, k);
+        }
+        if (!mask.empty()) {
+            remove_horizontal_seams(mask, positions, k);
+        }
+    } else {
+        pixels.remove_seams(positions, k, false);
+        remove_seams(gray, positions, k);
+        if (!forward()) {
+            remove_seams(energy, positions, k);
+        }
+        if (recording) {
+            remove_seams(origin, positions, k);
+        }
+        if (!mask.empty()) {
+            remove_seams(mask, positions, k);
+        }
+    }
+    update_energy(positions, k);
+    energy_pyramid.invalidate();
+    gray_pyramid.invalidate();
+    seam_count += k;
+    return k;
+}
+
+long long CarveSession::removed_energy() const {
+    return removed;
+}
+
+int CarveSession::seams_removed() const {
+    return seam_count;
+}
+
+void CarveSession::record_removal_order() {
+    recording = true;
+    origin.resize(pixels.width(), pixels.height());
+    order.resize(pixels.width(), pixels.height());
+    for (int y = 0; y < pixels.height(); y++) {
+        int *o = origin.row(y);
+        quint32 *r = order.row(y);
+        for (int x = 0; x < pixels.width(); x++) {
+            o[x] = horizontal ? y : x;
+            r[x] = 0xFFFFFFFF;
+        }
+    }
+}
+
+const Plane<quint32> &CarveSession::removal_order() const {
+    return order;
+}
+
+void CarveSession::record(const std::vector<int> &seam, int index) {
+    for (int i = 0; i < (int) seam.size(); i++) {
+        if (horizontal) {
+            order.at(i, origin.at(i, seam[i])) = index;
+        } else {
+            order.at(origin.at(seam[i], i), i) = index;
+        }
+    }
+}
+
+QImage CarveSession::result() const {
+    return pixels.to_image();
+}
+
+const PixelPlane &CarveSession::plane() const {
+    return pixels;
+}
+
+const std::vector<int> &CarveSession::last_seam() const {
+    return current_seam;
+}
+
+QImage CarveSession::energy_image() const {
+    QImage output;
+    if (forward()) {
+        Plane<int> forward_energy;
+        calc_energy_forward(gray, forward_energy, horizontal);
+        normalize(forward_energy, output);
+    } else {
+        normalize(energy, output);
+    }
+    return output;
+}
+
+int CarveSession::width() const {
+    return pixels.width();
+}
+
+int CarveSession::height() const {
+    return pixels.height();
+}
+
+int CarveSession::carve_size() const {
+    return horizontal ? pixels.height() : pixels.width();
+}
+
+bool CarveSession::forward() const {
+    return kernelX == nullptr || kernelY == nullptr;
+}
+
+bool CarveSession::mask_active() const {
+    return has_protect || remove_count > 0;
+}
+
+// 移除区域非空时只在其包围范围附近递推，找不到避开保护区域的路径时退回整幅图像
+bool CarveSession::find_masked_seam() {
+    const int lines = horizontal ? pixels.width() : pixels.height();
+    const int n = carve_size();
+    int lo = 0;
+    int hi = n - 1;
+    if (remove_count > 0) {
+        lo = qMax(0, remove_lo - mask_margin);
+        hi = qMin(n - 1, remove_hi + mask_margin);
+    }
+    for (;;) {
+        band_lo.assign(lines, lo);
+        band_hi.assign(lines, hi);
+        current_seam = forward() ? find_seam_forward_masked(gray, mask, band_lo, band_hi, horizontal)
+                                 : find_seam_masked(energy, mask, band_lo, band_hi, horizontal);
+        if (!current_seam.empty() || (lo == 0 && hi == n - 1)) {
+            return !current_seam.empty();
+        }
+        lo = 0;
+        hi = n - 1;
+    }
+}
+
+// seam 右侧（下方）的像素前移一位，剩余待移除像素只可能落在 [remove_lo - 1, remove_hi] 内，只需扫描这一带
+void CarveSession::update_remove_range() {
+    if (remove_count <= 0) {
+        remove_lo = carve_size();
+        remove_hi = -1;
+        return;
+    }
+    const int lo = qMax(0, remove_lo - 1);
+    const int hi = qMin(carve_size() - 1, remove_hi);
+    remove_lo = hi + 1;
+    remove_hi = lo - 1;
+    const int lines = horizontal ? mask.width() : mask.height();
+    for (int i = 0; i < lines; i++) {
+        for (int j = lo; j <= hi; j++) {
+            if ((horizontal ? mask.at(i, j) : mask.at(j, i)) == MaskRemove) {
+                remove_lo = qMin(remove_lo, j);
+                remove_hi = qMax(remove_hi, j);
+            }
+        }
+    }
+}
+
+long long CarveSession::seam_cost(const std::vector<int> &seam) const {
+    if (forward()) {
+        return forward_seam_cost(gray, seam, horizontal);
+    }
+    long long cost = 0;
+    for (int i = 0; i < (int) seam.size(); i++) {
+        cost += horizontal ? energy.at(i, seam[i]) : energy.at(seam[i], i);
+    }
+    return cost;
+}
+
+void CarveSession::update_energy(const std::vector<int> &positions, int k) {
+    if (forward()) {
+        return;
+    }
+    update_energy_band(gray, energy, *kernelX, *kernelY, window, positions, k, horizontal);
+}
+
+// 移除 seam 后，只有相邻三条线上 seam 位置附近的像素邻域发生了变化
+// 第 j 条（按位置排序）seam 在移除后位于 q = p - j，第 i 条线需要重算的范围是 [min(q) - 1, max(q)]，
+// 其中 min/max 取自第 i - 1 ~ i + 1 条线；竖直 seam 的线是行，水平 seam 的线是列
+void update_energy_band(
+    const Plane<uchar> &gray, Plane<int> &energy,
+    const Kernel &kernelX, const Kernel &kernelY, WindowEnergy window,
+    const std::vector<int> &positions, int k, bool horizontal
+) {
+    if (window != WindowEnergy::None) {
+        update_energy_window_band(gray, energy, window, positions, k, horizontal);
+        return;
+    }
+    const int lines = horizontal ? gray.width() : gray.height();
+    const int n = horizontal ? gray.height() : gray.width();
+    for (int i = 0; i < lines; i++) {
+        const int i0 = qMax(0, i - 1);
+        const int i1 = qMin(lines - 1, i + 1);
+        int done = -1;
+        for (int j = 0; j < k; j++) {
+            int lo = n;
+            int hi = -1;
+            for (int r = i0; r <= i1; r++) {
+                const int q = positions[(std::size_t) r * k + j] - j;
+                lo = qMin(lo, q);
+                hi = qMax(hi, q);
+            }
+            lo = qMax(done + 1, lo - 1);
+            hi = qMin(n - 1, hi);
+            if (lo > hi) {
+                continue;
+            }
+            if (horizontal) {
+                for (int y = lo; y <= hi; y++) {
+                    calc_energy_conv_span(gray, energy, y, i, i, kernelX, kernelY);
+                }
+            } else {
+                calc_energy_conv_span(gray, energy, i, lo, hi, kernelX, kernelY);
+            }
+            done = hi;
+        }
+    }
+}
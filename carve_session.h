@@ -0,0 +1,120 @@
+#ifndef CARVE_SESSION_H
+#define CARVE_SESSION_H
+
+#include "seam_carver.h"
+#include "image_plane.h"
+#include "seam_pyramid.h"
+#include "pixel_plane.h"
+
+#include <QImage>
+
+#include <vector>
+
+// 连续移除多条 seam 的会话
+// 灰度图与未正则化的能量在 seam 之间保留，每移除一条 seam 只重新计算其附近的窄带
+// 图像始终按原方向存放，水平 seam 直接逐列递推、在列内上移像素，不做转置
+// 各平面在移除 seam 时原地移动像素、只缩小逻辑尺寸，动态规划缓冲区在 seam 之间复用，
+// 因此逐条 carve() 时内存峰值不变，第一条 seam 之后不再分配
+class CarveSession
+{
+public:
+    // kernelX 与 kernelY 为空时使用前向能量；window 为 find_kernels 给出的窗口能量
+    CarveSession(
+        const QImage &image,
+        const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+        bool horizontal = false
+    );
+
+    // 多分辨率模式：carve() 在 levels 层下采样图上寻找 seam，再在原图上投影路径两侧 band 个像素内细化
+    // levels 为 0 时使用完整的动态规划
+    void set_pyramid(int levels, int band);
+
+    // 保护/移除掩码（取值见 SeamMask），尺寸须与图像相同，须在移除第一条 seam 之前调用
+    // 还有待移除的像素时，seam 只在它们的包围范围两侧各扩展 margin 个像素的带内寻找，
+    // 代价与物体的大小而不是图像的大小成正比；带内没有避开保护区域的路径时再在整幅图像上寻找
+    // 使用掩码时不使用多分辨率与近似模式
+    void set_mask(const Plane<uchar> &mask, int margin = 8);
+    // 尚未移除的移除区域像素数
+    long long remove_left() const;
+    // 已移除 seam 后的掩码，与 result() 同尺寸
+    const Plane<uchar> &current_mask() const;
+
+    // 移除一条 seam，没有可移除的 seam（尺寸为 1 或被保护区域阻断）时返回 false
+    bool carve();
+    // 快速近似模式：从一张累积能量图中取出至多 k 条互不相交的 seam 一起移除，返回实际移除的条数
+    int carve_multiple(int k);
+
+    // 已移除 seam 在移除时的能量之和（前向能量时为移除后新产生的代价），用于比较近似模式与逐条移除的质量
+    long long removed_energy() const;
+    // 已移除的 seam 条数
+    int seams_removed() const;
+
+    // 开始记录每个原图像素被第几条 seam 移除，须在移除第一条 seam 之前调用
+    void record_removal_order();
+    // 按原图尺寸存放的移除顺序，未被移除的像素为 0xFFFFFFFF
+    const Plane<quint32> &removal_order() const;
+
+    // 当前图像
+    QImage result() const;
+    // 当前图像的像素（原格式），不复制，下一次移除 seam 后改变
+    const PixelPlane &plane() const;
+    // 最近一次 carve() 移除的 seam
+    const std::vector<int> &last_seam() const;
+    // 正则化到 0~255 的能量图，仅用于显示
+    QImage energy_image() const;
+
+    int width() const;
+    int height() const;
+
+private:
+    const Kernel *kernelX;
+    const Kernel *kernelY;
+    WindowEnergy window;
+    // 通用卷积核在水平方向上需要转置
+    Kernel transposedX;
+    Kernel transposedY;
+    bool horizontal;
+    PixelPlane pixels;
+    Plane<uchar> gray;
+    // 卷积能量，前向能量时为空
+    Plane<int> energy;
+    long long removed = 0;
+    int seam_count = 0;
+    // origin 为当前每个像素在原图中沿 seam 方向的坐标（竖直 seam 为 x，水平 seam 为 y）
+    bool recording = false;
+    Plane<int> origin;
+    Plane<quint32> order;
+    SeamPyramid<int> energy_pyramid;
+    SeamPyramid<uchar> gray_pyramid;
+    SeamScratch scratch;
+    std::vector<int> current_seam;
+    // 与图像一起移除 seam 的掩码；remove_lo ~ remove_hi 为待移除像素在 seam 方向上的包围范围
+    Plane<uchar> mask;
+    bool has_protect = false;
+    long long remove_count = 0;
+    int remove_lo = 0;
+    int remove_hi = -1;
+    int mask_margin = 0;
+    std::vector<int> band_lo;
+    std::vector<int> band_hi;
+
+    // seam 所在方向上的尺寸，即每次移除后减一的那一维
+    int carve_size() const;
+    bool forward() const;
+    bool mask_active() const;
+    bool find_masked_seam();
+    void update_remove_range();
+    long long seam_cost(const std::vector<int> &seam) const;
+    void record(const std::vector<int> &seam, int index);
+    void update_energy(const std::vector<int> &positions, int k);
+};
+
+// 移除 k 条 seam 后只重新计算 energy 中受影响的窄带，gray 与 energy 须已移除这些 seam
+// positions 的排列与 remove_seams / remove_horizontal_seams 相同，window 与 calc_energy_conv 相同
+void update_energy_band(
+    const Plane<uchar> &gray, Plane<int> &energy,
+    const Kernel &kernelX, const Kernel &kernelY, WindowEnergy window,
+    const std::vector<int> &positions, int k, bool horizontal
+);
+
+#endif // CARVE_SESSION_H
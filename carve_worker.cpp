@@ -0,0 +1,106 @@
+#include "carve_worker.h"
+#include "carve_session.h"
+#include "retarget_2d.h"
+#include "seam_insertion.h"
+
+#include <algorithm>
+#include <climits>
+
+CarveWorker::CarveWorker(
+    const QImage &image,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    int target_width, int target_height,
+    QObject *parent
+) : QThread(parent), image(image), kernelX(kernelX), kernelY(kernelY), window(window),
+    target_width(qMax(1, target_width)), target_height(qMax(1, target_height)) {}
+
+void CarveWorker::cancel() {
+    cancelled = true;
+}
+
+void CarveWorker::set_energy(bool energy) {
+    this->energy = energy;
+}
+
+void CarveWorker::set_preview_scale(double scale) {
+    proxy = PreviewProxy(scale);
+}
+
+void CarveWorker::set_frame_interval(int msec) {
+    frame_interval = qMax(1, msec);
+}
+
+void CarveWorker::frame_shown() {
+    frame_pending = false;
+}
+
+// 竖直 seam 只改变它最左端右侧的列，水平 seam 只改变它最高点以下的行
+void CarveWorker::seam_removed(const std::vector<int> &seam, bool horizontal) {
+    const int first = *std::min_element(seam.begin(), seam.end());
+    if (horizontal) {
+        changed_y = qMin(changed_y, first);
+    } else {
+        changed_x = qMin(changed_x, first);
+    }
+}
+
+// 距上一帧超过 frame_interval、且界面已显示上一帧时，才更新预览中变化的条带并发送
+template <typename Session>
+void CarveWorker::report(const Session &session, int done, int total) {
+    if (frame_pending || timer.elapsed() < frame_interval) {
+        return;
+    }
+    timer.restart();
+    proxy.update(session.plane(), changed_x, changed_y);
+    changed_x = INT_MAX;
+    changed_y = INT_MAX;
+    frame_pending = true;
+    emit progress(proxy.image(), energy ? preview_image(session.energy_image(), proxy.scale()) : QImage(), done, total);
+}
+
+void CarveWorker::run() {
+    timer.start();
+    changed_x = 0;
+    changed_y = 0;
+    QImage output = image;
+    QImage output_energy;
+    const int shrink_width = qMax(0, image.width() - target_width);
+    const int shrink_height = qMax(0, image.height() - target_height);
+    const int total = shrink_width + shrink_height;
+
+    if (shrink_width > 0 && shrink_height > 0) {
+        Retarget2D retarget(image, kernelX, kernelY, window);
+        for (int done = 1; !cancelled && retarget.step(target_width, target_height); done++) {
+            seam_removed(retarget.last_seam(), retarget.last_horizontal());
+            report(retarget, done, total);
+        }
+        output = retarget.result();
+        if (energy) {
+            output_energy = retarget.energy_image();
+        }
+    } else if (total > 0) {
+        const bool horizontal = shrink_height > 0;
+        const int target = horizontal ? target_height : target_width;
+        CarveSession session(image, kernelX, kernelY, window, horizontal);
+        for (int done = 1; !cancelled && (horizontal ? session.height() : session.width()) > target; done++) {
+            session.carve();
+            seam_removed(session.last_seam(), horizontal);
+            report(session, done, total);
+        }
+        output = session.result();
+        if (energy) {
+            output_energy = session.energy_image();
+        }
+    }
+
+    // 放大时一次插入全部 seam，没有中间结果
+    if (!cancelled && output.width() < target_width) {
+        output = insert_seams(output, target_width - output.width(), kernelX, kernelY, window, false);
+        output_energy = QImage();
+    }
+    if (!cancelled && output.height() < target_height) {
+        output = insert_seams(output, target_height - output.height(), kernelX, kernelY, window, true);
+        output_energy = QImage();
+    }
+    emit carved(output, output_energy, cancelled);
+}
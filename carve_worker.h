@@ -0,0 +1,73 @@
+#ifndef CARVE_WORKER_H
+#define CARVE_WORKER_H
+
+#include "seam_carver.h"
+#include "preview_proxy.h"
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QThread>
+
+#include <atomic>
+
+// 在后台线程中把图像缩放到目标尺寸，界面线程只接收信号
+// 缩小时逐条移除 seam（两个方向都缩小时使用 Retarget2D），放大时插入 seam，可以随时取消
+// 中间结果是显示分辨率的预览图，只重新采样上一帧之后被 seam 改变的条带；
+// 两帧之间至少间隔 frame_interval 毫秒，并且界面调用 frame_shown() 之前不发送下一帧
+class CarveWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    static const int default_frame_interval = 40;
+
+    // kernelX 与 kernelY 为空时使用前向能量，window 为 find_kernels 给出的窗口能量
+    CarveWorker(
+        const QImage &image,
+        const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+        int target_width, int target_height,
+        QObject *parent = nullptr
+    );
+
+    // 在下一条 seam 之前停止，已移除的 seam 保留
+    void cancel();
+    // 是否同时发送能量图
+    void set_energy(bool energy);
+    // 预览与原图的尺寸比例，须在 start() 之前设置
+    void set_preview_scale(double scale);
+    // 两帧之间的最短间隔，通常取屏幕的刷新间隔
+    void set_frame_interval(int msec);
+    // 界面已显示收到的一帧
+    void frame_shown();
+
+signals:
+    // preview 为显示分辨率的预览图，energy 只在需要显示能量图时不为空（同样是预览尺寸）；done 为已处理的 seam 数
+    void progress(const QImage &preview, const QImage &energy, int done, int total);
+    void carved(const QImage &image, const QImage &energy, bool cancelled);
+
+protected:
+    void run() override;
+
+private:
+    QImage image;
+    const Kernel *kernelX;
+    const Kernel *kernelY;
+    WindowEnergy window;
+    int target_width;
+    int target_height;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> energy{false};
+    std::atomic<int> frame_interval{default_frame_interval};
+    std::atomic<bool> frame_pending{false};
+    QElapsedTimer timer;
+    PreviewProxy proxy;
+    // 上一帧之后图像可能改变的起始列与起始行
+    int changed_x = 0;
+    int changed_y = 0;
+
+    void seam_removed(const std::vector<int> &seam, bool horizontal);
+    template <typename Session>
+    void report(const Session &session, int done, int total);
+};
+
+#endif // CARVE_WORKER_H
@@ -0,0 +1,151 @@
+#include "energy_kernels.h"
+#include "seam_carver.h"
+
+#include <atomic>
+
+#ifdef SEAM_CARVER_X86
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+static SimdLevel detect_simd_level() {
+#ifdef SEAM_CARVER_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#endif
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+static std::atomic<int> forced_level{-1};
+
+SimdLevel simd_level() {
+    static const SimdLevel detected = detect_simd_level();
+    const int forced = forced_level.load(std::memory_order_relaxed);
+    if (forced >= 0 && forced < (int) detected) {
+        return (SimdLevel) forced;
+    }
+    return detected;
+}
+
+void set_simd_level(SimdLevel level) {
+    forced_level = (int) level;
+}
+
+#ifdef SEAM_CARVER_X86
+
+template <int W>
+static inline __m128i conv_tap_sse2(__m128i acc, __m128i pixel) {
+    if constexpr (W == 0) {
+        return acc;
+    } else if constexpr (W == 1) {
+        return _mm_add_epi16(acc, pixel);
+    } else if constexpr (W == -1) {
+        return _mm_sub_epi16(acc, pixel);
+    } else {
+        return _mm_add_epi16(acc, _mm_mullo_epi16(pixel, _mm_set1_epi16(W)));
+    }
+}
+
+// 8 个像素一组，在 16 位整数上累加（Scharr 的 |gx| + |gy| 最大为 16320，不会溢出）
+template <const Kernel &KX, const Kernel &KY>
+void conv_energy_row_sse2(const uchar *const lines[3], int *energy, int x0, int x1) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = x0;
+    for (; x + 8 <= x1; x += 8) {
+        __m128i v[3][3];
+        for (int l = 0; l < 3; l++) {
+            for (int k = 0; k < 3; k++) {
+                __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(lines[l] + x + k - 1));
+                v[k][l] = _mm_unpacklo_epi8(bytes, zero);
+            }
+        }
+        __m128i gx = zero;
+        __m128i gy = zero;
+#define SEAM_CARVER_TAP(k, l) \
+        gx = conv_tap_sse2<KX[k][l]>(gx, v[k][l]); \
+        gy = conv_tap_sse2<KY[k][l]>(gy, v[k][l]);
+        SEAM_CARVER_TAP(0, 0) SEAM_CARVER_TAP(0, 1) SEAM_CARVER_TAP(0, 2)
+        SEAM_CARVER_TAP(1, 0) SEAM_CARVER_TAP(1, 1) SEAM_CARVER_TAP(1, 2)
+        SEAM_CARVER_TAP(2, 0) SEAM_CARVER_TAP(2, 1) SEAM_CARVER_TAP(2, 2)
+#undef SEAM_CARVER_TAP
+        // SSE2 没有 abs 指令，用 max(v, -v)
+        gx = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx));
+        gy = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+        __m128i e = _mm_srli_epi16(_mm_add_epi16(gx, gy), 1);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(energy + x), _mm_unpacklo_epi16(e, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(energy + x + 4), _mm_unpackhi_epi16(e, zero));
+    }
+    conv_energy_row_tail<KX, KY>(lines, energy, x, x1);
+}
+
+#define SEAM_CARVER_KERNELS(X, Y) { \
+    &conv_energy_span<X, Y>, &conv_energy_row_sse2<X, Y>, &conv_energy_row_avx2<X, Y> }
+
+#else
+
+#define SEAM_CARVER_KERNELS(X, Y) { &conv_energy_span<X, Y>, nullptr, nullptr }
+
+#endif
+
+static const ConvEnergyKernels sobel_kernels = SEAM_CARVER_KERNELS(SobelX, SobelY);
+static const ConvEnergyKernels prewitt_kernels = SEAM_CARVER_KERNELS(PrewittX, PrewittY);
+static const ConvEnergyKernels scharr_kernels = SEAM_CARVER_KERNELS(ScharrX, ScharrY);
+static const ConvEnergyKernels roberts_kernels = SEAM_CARVER_KERNELS(RobertsX, RobertsY);
+
+#undef SEAM_CARVER_KERNELS
+
+const ConvEnergyKernels *find_conv_energy_kernels(const Kernel &kernelX, const Kernel &kernelY) {
+    if (&kernelX == &SobelX && &kernelY == &SobelY) {
+        return &sobel_kernels;
+    } else if (&kernelX == &PrewittX && &kernelY == &PrewittY) {
+        return &prewitt_kernels;
+    } else if (&kernelX == &ScharrX && &kernelY == &ScharrY) {
+        return &scharr_kernels;
+    } else if (&kernelX == &RobertsX && &kernelY == &RobertsY) {
+        return &roberts_kernels;
+    }
+    return nullptr;
+}
+
+void conv_energy_row(
+    const ConvEnergyKernels &kernels,
+    const Plane<uchar> &gray, Plane<int> &output, int y
+) {
+    const int col = gray.width();
+    const int row = gray.height();
+    const SimdLevel level = simd_level();
+    if (col < 3 || level == SimdLevel::Scalar) {
+        kernels.span(gray, output, y, 0, col - 1);
+        return;
+    }
+
+    // 首尾两列需要截断，走标量路径；中间的列不会越界
+    const uchar *lines[3] = {
+        gray.row(qMax(0, y - 1)), gray.row(y), gray.row(qMin(row - 1, y + 1))
+    };
+    kernels.span(gray, output, y, 0, 0);
+    if (level == SimdLevel::AVX2) {
+        kernels.row_avx2(lines, output.row(y), 1, col - 1);
+    } else {
+        kernels.row_sse2(lines, output.row(y), 1, col - 1);
+    }
+    kernels.span(gray, output, y, col - 1, col - 1);
+}
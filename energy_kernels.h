@@ -0,0 +1,99 @@
+#ifndef ENERGY_KERNELS_H
+#define ENERGY_KERNELS_H
+
+#include "image_plane.h"
+
+#include <QtGlobal>
+
+typedef int Kernel[3][3];
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SEAM_CARVER_X86 1
+#endif
+
+// 针对每组卷积核在编译期展开的能量计算
+// Kernel 的下标为 [x 偏移 + 1][y 偏移 + 1]，与 calc_energy_conv 的参考实现一致；
+// 系数为 0 的项在编译期被去掉
+
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+// 当前使用的指令集，首次调用时检测 CPU
+SimdLevel simd_level();
+// 强制使用某一指令集（不能高于 CPU 支持的级别），用于对比测试与基准
+void set_simd_level(SimdLevel level);
+
+template <int W>
+inline int conv_tap(int acc, int pixel) {
+    if constexpr (W == 0) {
+        return acc;
+    } else if constexpr (W == 1) {
+        return acc + pixel;
+    } else if constexpr (W == -1) {
+        return acc - pixel;
+    } else {
+        return acc + pixel * W;
+    }
+}
+
+// lines 为 y - 1、y、y + 1 三行（已按边界截断），xs 为 x - 1、x、x + 1 三列
+template <const Kernel &KX, const Kernel &KY>
+inline int conv_energy_at(const uchar *const lines[3], const int xs[3]) {
+    int gx = 0;
+    int gy = 0;
+#define SEAM_CARVER_TAP(k, l) \
+    gx = conv_tap<KX[k][l]>(gx, lines[l][xs[k]]); \
+    gy = conv_tap<KY[k][l]>(gy, lines[l][xs[k]]);
+    SEAM_CARVER_TAP(0, 0) SEAM_CARVER_TAP(0, 1) SEAM_CARVER_TAP(0, 2)
+    SEAM_CARVER_TAP(1, 0) SEAM_CARVER_TAP(1, 1) SEAM_CARVER_TAP(1, 2)
+    SEAM_CARVER_TAP(2, 0) SEAM_CARVER_TAP(2, 1) SEAM_CARVER_TAP(2, 2)
+#undef SEAM_CARVER_TAP
+    return (qAbs(gx) + qAbs(gy)) / 2;
+}
+
+// 标量版本，处理任意 [x0, x1] 区间（含图像边界）
+template <const Kernel &KX, const Kernel &KY>
+void conv_energy_span(const Plane<uchar> &gray, Plane<int> &output, int y, int x0, int x1) {
+    const int col = gray.width();
+    const int row = gray.height();
+    const uchar *lines[3] = {
+        gray.row(qMax(0, y - 1)), gray.row(y), gray.row(qMin(row - 1, y + 1))
+    };
+    int *energy = output.row(y);
+    for (int x = x0; x <= x1; x++) {
+        const int xs[3] = {qMax(0, x - 1), x, qMin(col - 1, x + 1)};
+        energy[x] = conv_energy_at<KX, KY>(lines, xs);
+    }
+}
+
+// 向量化版本，只处理内部列 [x0, x1)，要求 x0 >= 1 且 x1 <= 宽度 - 1
+template <const Kernel &KX, const Kernel &KY>
+void conv_energy_row_sse2(const uchar *const lines[3], int *energy, int x0, int x1);
+template <const Kernel &KX, const Kernel &KY>
+void conv_energy_row_avx2(const uchar *const lines[3], int *energy, int x0, int x1);
+
+// 对内部列做不截断的标量计算，用于向量化循环的尾部
+template <const Kernel &KX, const Kernel &KY>
+inline void conv_energy_row_tail(const uchar *const lines[3], int *energy, int x0, int x1) {
+    for (int x = x0; x < x1; x++) {
+        const int xs[3] = {x - 1, x, x + 1};
+        energy[x] = conv_energy_at<KX, KY>(lines, xs);
+    }
+}
+
+// 一组卷积核对应的特化函数
+struct ConvEnergyKernels {
+    void (*span)(const Plane<uchar> &, Plane<int> &, int, int, int);
+    void (*row_sse2)(const uchar *const[3], int *, int, int);
+    void (*row_avx2)(const uchar *const[3], int *, int, int);
+};
+
+// 查找 kernelX/kernelY 对应的特化函数，不是预定义的卷积核时返回 nullptr
+const ConvEnergyKernels *find_conv_energy_kernels(const Kernel &kernelX, const Kernel &kernelY);
+
+// 使用特化函数计算一整行能量，按 simd_level() 选择内部列的实现
+void conv_energy_row(
+    const ConvEnergyKernels &kernels,
+    const Plane<uchar> &gray, Plane<int> &output, int y
+);
+
+#endif // ENERGY_KERNELS_H
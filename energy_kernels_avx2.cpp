@@ -0,0 +1,76 @@
+#include "energy_kernels.h"
+#include "seam_carver.h"
+
+// 本文件按默认指令集编译，只有下面标注了 SEAM_CARVER_AVX2 的函数使用 AVX2，只在 simd_level() 为 AVX2 时被调用。
+// 整个文件以 -mavx2 编译时，头文件中的内联函数（conv_energy_at、conv_energy_row_tail、Plane 的访问函数等）
+// 也会生成 AVX2 版本，链接器可能把它们用于标量/SSE2 的调用者，在不支持 AVX2 的 CPU 上触发非法指令
+
+#ifdef SEAM_CARVER_X86
+#include <immintrin.h>
+
+// MSVC 不需要指令集选项即可使用 AVX2 内建函数
+#if defined(__GNUC__) || defined(__clang__)
+#define SEAM_CARVER_AVX2 __attribute__((target("avx2")))
+#else
+#define SEAM_CARVER_AVX2
+#endif
+
+namespace {
+
+template <int W>
+SEAM_CARVER_AVX2 inline __m256i conv_tap_avx2(__m256i acc, __m256i pixel) {
+    if constexpr (W == 0) {
+        return acc;
+    } else if constexpr (W == 1) {
+        return _mm256_add_epi16(acc, pixel);
+    } else if constexpr (W == -1) {
+        return _mm256_sub_epi16(acc, pixel);
+    } else {
+        return _mm256_add_epi16(acc, _mm256_mullo_epi16(pixel, _mm256_set1_epi16(W)));
+    }
+}
+
+// 16 个像素一组，累加方式与 SSE2 版本相同
+template <const Kernel &KX, const Kernel &KY>
+SEAM_CARVER_AVX2 void row_avx2(const uchar *const lines[3], int *energy, int x0, int x1) {
+    int x = x0;
+    for (; x + 16 <= x1; x += 16) {
+        __m256i v[3][3];
+        for (int l = 0; l < 3; l++) {
+            for (int k = 0; k < 3; k++) {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lines[l] + x + k - 1));
+                v[k][l] = _mm256_cvtepu8_epi16(bytes);
+            }
+        }
+        __m256i gx = _mm256_setzero_si256();
+        __m256i gy = _mm256_setzero_si256();
+#define SEAM_CARVER_TAP(k, l) \
+        gx = conv_tap_avx2<KX[k][l]>(gx, v[k][l]); \
+        gy = conv_tap_avx2<KY[k][l]>(gy, v[k][l]);
+        SEAM_CARVER_TAP(0, 0) SEAM_CARVER_TAP(0, 1) SEAM_CARVER_TAP(0, 2)
+        SEAM_CARVER_TAP(1, 0) SEAM_CARVER_TAP(1, 1) SEAM_CARVER_TAP(1, 2)
+        SEAM_CARVER_TAP(2, 0) SEAM_CARVER_TAP(2, 1) SEAM_CARVER_TAP(2, 2)
+#undef SEAM_CARVER_TAP
+        __m256i e = _mm256_srli_epi16(_mm256_add_epi16(_mm256_abs_epi16(gx), _mm256_abs_epi16(gy)), 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(energy + x),
+                            _mm256_cvtepu16_epi32(_mm256_castsi256_si128(e)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(energy + x + 8),
+                            _mm256_cvtepu16_epi32(_mm256_extracti128_si256(e, 1)));
+    }
+    conv_energy_row_tail<KX, KY>(lines, energy, x, x1);
+}
+
+}
+
+// 对外只导出下面显式实例化的函数，本身不使用 AVX2
+template <const Kernel &KX, const Kernel &KY>
+void conv_energy_row_avx2(const uchar *const lines[3], int *energy, int x0, int x1) {
+    row_avx2<KX, KY>(lines, energy, x0, x1);
+}
+
+template void conv_energy_row_avx2<SobelX, SobelY>(const uchar *const[3], int *, int, int);
+template void conv_energy_row_avx2<PrewittX, PrewittY>(const uchar *const[3], int *, int, int);
+template void conv_energy_row_avx2<ScharrX, ScharrY>(const uchar *const[3], int *, int, int);
+template void conv_energy_row_avx2<RobertsX, RobertsY>(const uchar *const[3], int *, int, int);
+
+#endif
@@ -0,0 +1,120 @@
+#include "seam_carver.h"
+#include "energy_kernels.h"
+
+#include <cstdio>
+#include <random>
+
+// 向量化的卷积能量与标量参考实现逐位比较：每种可用的指令集、四组预定义卷积核、
+// 宽度 1~3 与各种不足一组向量的尾部，以及 calc_energy_conv_span 的任意区间
+
+struct KernelPair {
+    const char *name;
+    const Kernel *x;
+    const Kernel *y;
+};
+
+static const KernelPair kernel_pairs[] = {
+    {"Sobel", &SobelX, &SobelY},
+    {"Prewitt", &PrewittX, &PrewittY},
+    {"Scharr", &ScharrX, &ScharrY},
+    {"Roberts", &RobertsX, &RobertsY},
+};
+
+static const char *level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar: return "scalar";
+    case SimdLevel::SSE2: return "SSE2";
+    default: return "AVX2";
+    }
+}
+
+static void random_plane(std::mt19937 &rng, int width, int height, Plane<uchar> &plane) {
+    plane.resize(width, height);
+    for (int y = 0; y < height; y++) {
+        uchar *line = plane.row(y);
+        for (int x = 0; x < width; x++) {
+            // 一半的平面只取 0 与 255，覆盖 16 位累加的极值
+            line[x] = (height & 1) ? (uchar) rng() : (rng() & 1) * 255;
+        }
+    }
+}
+
+// 返回不一致的像素数，并打印第一个
+static int compare(const Plane<int> &expected, const Plane<int> &actual, const char *what, const KernelPair &kernels, SimdLevel level) {
+    int mismatches = 0;
+    for (int y = 0; y < expected.height(); y++) {
+        for (int x = 0; x < expected.width(); x++) {
+            if (expected.at(x, y) != actual.at(x, y)) {
+                if (mismatches == 0) {
+                    std::fprintf(stderr, "%s %s %s %dx%d: (%d, %d) expected %d, got %d\n",
+                                 what, kernels.name, level_name(level), expected.width(), expected.height(),
+                                 x, y, expected.at(x, y), actual.at(x, y));
+                }
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main() {
+    // 强制为 AVX2 时 simd_level() 返回 CPU 实际支持的最高级别
+    set_simd_level(SimdLevel::AVX2);
+    const SimdLevel detected = simd_level();
+    std::vector<SimdLevel> levels = {SimdLevel::Scalar};
+    if (detected >= SimdLevel::SSE2) {
+        levels.push_back(SimdLevel::SSE2);
+    }
+    if (detected >= SimdLevel::AVX2) {
+        levels.push_back(SimdLevel::AVX2);
+    }
+
+    // 1~3 为宽度不足以向量化的情况，其余覆盖 SSE2（8）与 AVX2（16）的各种尾部
+    const int widths[] = {1, 2, 3, 4, 5, 9, 10, 15, 17, 18, 31, 33, 34, 47, 64, 65, 127, 130};
+    const int heights[] = {1, 2, 3, 7, 16};
+
+    std::mt19937 rng(2024);
+    int failures = 0;
+    for (SimdLevel level : levels) {
+        set_simd_level(level);
+        for (const KernelPair &kernels : kernel_pairs) {
+            for (int width : widths) {
+                for (int height : heights) {
+                    Plane<uchar> gray;
+                    random_plane(rng, width, height, gray);
+                    Plane<int> expected;
+                    Plane<int> actual;
+                    calc_energy_conv_reference(gray, expected, *kernels.x, *kernels.y);
+                    calc_energy_conv(gray, actual, *kernels.x, *kernels.y);
+                    failures += compare(expected, actual, "calc_energy_conv", kernels, level) != 0;
+
+                    // 逐行在随机区间上重新计算，区间外保持为 -1
+                    Plane<int> span_expected(width, height);
+                    Plane<int> span_actual(width, height);
+                    for (int y = 0; y < height; y++) {
+                        int x0 = rng() % width;
+                        int x1 = rng() % width;
+                        if (x0 > x1) {
+                            std::swap(x0, x1);
+                        }
+                        for (int x = 0; x < width; x++) {
+                            span_expected.at(x, y) = -1;
+                            span_actual.at(x, y) = -1;
+                        }
+                        calc_energy_conv_reference_span(gray, span_expected, y, x0, x1, *kernels.x, *kernels.y);
+                        calc_energy_conv_span(gray, span_actual, y, x0, x1, *kernels.x, *kernels.y);
+                    }
+                    failures += compare(span_expected, span_actual, "calc_energy_conv_span", kernels, level) != 0;
+                }
+            }
+        }
+        std::printf("%s: checked\n", level_name(level));
+    }
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d mismatching cases\n", failures);
+        return 1;
+    }
+    std::printf("all kernels bit-exact\n");
+    return 0;
+}
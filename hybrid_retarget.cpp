@@ -0,0 +1,82 @@
+#include "hybrid_retarget.h"
+#include "carve_session.h"
+#include "seam_map.h"
+#include "trace.h"
+
+bool seam_cost_knee(const std::vector<long long> &cumulative, int window, double knee, long long min_cost) {
+    const int n = (int) cumulative.size();
+    window = qMax(1, window);
+    // 拐点之前至少要有与窗口同样多的 seam 作为基准
+    if (n < 2 * window) {
+        return false;
+    }
+    const long long before = cumulative[n - 1 - window];
+    const double recent = (double) (cumulative[n - 1] - before) / window;
+    const double average = qMax((double) before / (n - window), (double) min_cost);
+    return recent > knee * average;
+}
+
+// 沿一个方向逐条移除 seam，直到 target 或代价曲线越过拐点；
+// 越过拐点时退回到变陡的 window 条 seam 之前，由移除顺序重新生成图像，返回保留的 seam 条数
+static int carve_until_knee(
+    QImage &image, int target, bool horizontal,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window_energy,
+    const HybridOptions &options, long long &removed
+) {
+    const int size = horizontal ? image.height() : image.width();
+    const int seams = size - target;
+    if (seams <= 0) {
+        return 0;
+    }
+    const int window = options.window > 0 ? options.window : qMax(4, seams / 20);
+    // 平均每像素至少为 1，seam 的长度是另一方向的尺寸
+    const long long min_cost = horizontal ? image.width() : image.height();
+
+    CarveSession session(image, kernelX, kernelY, window_energy, horizontal);
+    session.record_removal_order();
+    std::vector<long long> cumulative;
+    cumulative.reserve(seams);
+    bool knee = false;
+    while ((int) cumulative.size() < seams && !knee) {
+        if (!session.carve()) {
+            break;
+        }
+        cumulative.push_back(session.removed_energy());
+        knee = seam_cost_knee(cumulative, window, options.knee, min_cost);
+    }
+    if (!knee) {
+        removed += session.removed_energy();
+        image = session.result();
+        return (int) cumulative.size();
+    }
+
+    const int kept = (int) cumulative.size() - window;
+    removed += cumulative[kept - 1];
+    const SeamMap map = seam_map_from_order(session.removal_order(), (int) cumulative.size(), horizontal);
+    image = retarget_with_seam_map(image, map, size - kept);
+    return kept;
+}
+
+QImage hybrid_retarget(
+    const QImage &image, int width, int height,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window_energy,
+    const HybridOptions &options, HybridStats *stats
+) {
+    SEAM_CARVER_TRACE_SCOPE("hybrid_retarget");
+    width = qMin(qMax(1, width), image.width());
+    height = qMin(qMax(1, height), image.height());
+    HybridStats result;
+    QImage output = image;
+    result.seams[0] = carve_until_knee(output, width, false, kernelX, kernelY, window_energy, options, result.removed);
+    result.seams[1] = carve_until_knee(output, height, true, kernelX, kernelY, window_energy, options, result.removed);
+    result.scaled[0] = output.width() - width;
+    result.scaled[1] = output.height() - height;
+    if (output.width() != width || output.height() != height) {
+        SEAM_CARVER_TRACE_PIXELS("hybrid_scale", (long long) output.width() * output.height());
+        output = output.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    if (stats != nullptr) {
+        *stats = result;
+    }
+    return output;
+}
@@ -0,0 +1,43 @@
+#ifndef HYBRID_RETARGET_H
+#define HYBRID_RETARGET_H
+
+#include "seam_carver.h"
+
+#include <QImage>
+
+#include <vector>
+
+// 先移除 seam、再缩放的混合缩小
+// 低代价的 seam 集中在前面，越往后的 seam 越难找、对画面的破坏也越大。
+// 逐条移除时记录累积代价曲线，曲线明显变陡时停止，剩余的尺寸用一次平滑缩放完成，
+// 大比例缩小时只需移除其中一部分 seam
+struct HybridOptions {
+    // 最近 window 条 seam 的平均代价超过此前平均代价的 knee 倍时切换到缩放
+    double knee = 2.0;
+    // <= 0 时取要移除条数的 1/20，至少 4 条
+    int window = 0;
+};
+
+struct HybridStats {
+    // 竖直/水平方向上移除的 seam 条数与由缩放完成的像素数，下标 0 为宽度、1 为高度
+    int seams[2] = {0, 0};
+    int scaled[2] = {0, 0};
+    // 被移除 seam 的能量之和
+    long long removed = 0;
+};
+
+// cumulative[i] 为前 i + 1 条 seam 的累积代价，返回曲线在最后 window 条 seam 上是否已经越过拐点，
+// 即这几条的平均代价超过之前各条平均代价的 knee 倍；之前的平均代价至少按 min_cost 计，
+// 避免平坦区域中接近 0 的代价使切换过早
+bool seam_cost_knee(const std::vector<long long> &cumulative, int window, double knee, long long min_cost);
+
+// 把 image 缩小到 width x height，不小于原尺寸的方向不变；kernelX 与 kernelY 为空时使用前向能量，
+// window_energy 为 find_kernels 给出的窗口能量
+// 先缩小宽度再缩小高度，各自在拐点处停止，最后一次缩放到目标尺寸
+QImage hybrid_retarget(
+    const QImage &image, int width, int height,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window_energy,
+    const HybridOptions &options = HybridOptions(), HybridStats *stats = nullptr
+);
+
+#endif // HYBRID_RETARGET_H
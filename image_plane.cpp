@@ -0,0 +1,23 @@
+#include "image_plane.h"
+
+#include <cstring>
+
+void image_to_plane(const QImage &image, Plane<QRgb> &output) {
+    const QImage source = image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_RGB32
+        ? image : image.convertToFormat(QImage::Format_ARGB32);
+    output.resize(source.width(), source.height());
+    for (int y = 0; y < source.height(); y++) {
+        std::memcpy(output.row(y), source.constScanLine(y), source.width() * sizeof(QRgb));
+    }
+}
+
+QImage plane_to_image(const Plane<QRgb> &plane, QImage::Format format) {
+    QImage image(plane.width(), plane.height(), QImage::Format_ARGB32);
+    for (int y = 0; y < plane.height(); y++) {
+        std::memcpy(image.scanLine(y), plane.row(y), plane.width() * sizeof(QRgb));
+    }
+    if (format != QImage::Format_ARGB32 && format != QImage::Format_Invalid) {
+        return image.convertToFormat(format);
+    }
+    return image;
+}
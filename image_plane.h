@@ -0,0 +1,121 @@
+#ifndef IMAGE_PLANE_H
+#define IMAGE_PLANE_H
+
+#include "trace.h"
+
+#include <QImage>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <numeric>
+#include <vector>
+
+// 行首按 64 字节对齐的分配器，便于向量化访问整行
+template <typename T>
+struct AlignedAllocator {
+    typedef T value_type;
+    static constexpr std::size_t alignment = 64;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U> &) {}
+
+    T *allocate(std::size_t n) {
+        SEAM_CARVER_TRACE_ALLOC(n * sizeof(T));
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+    }
+    void deallocate(T *p, std::size_t) {
+        ::operator delete(p, std::align_val_t(alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U> &) const { return false; }
+};
+
+// 连续、按行存储的二维数组，stride 以元素个数计，每行起始地址都按 64 字节对齐
+template <typename T>
+class Plane
+{
+public:
+    Plane() = default;
+    Plane(int width, int height) { resize(width, height); }
+
+    void resize(int width, int height) {
+        w = width;
+        h = height;
+        s = aligned_stride(width);
+        buffer.assign(s * height, T());
+    }
+
+    // 只缩小逻辑尺寸，stride、缓冲区与已有内容都不变，用于原地移除 seam
+    void truncate(int width, int height) {
+        w = width;
+        h = height;
+    }
+
+    // 改变尺寸但不初始化内容，缓冲区足够大时不重新分配，用于每次都会整体重写的临时平面
+    void reshape(int width, int height) {
+        w = width;
+        h = height;
+        s = aligned_stride(width);
+        if ((std::size_t) (s * height) > buffer.size()) {
+            buffer.resize(s * height);
+        }
+    }
+
+    int width() const { return w; }
+    int height() const { return h; }
+    std::ptrdiff_t stride() const { return s; }
+    bool empty() const { return w == 0 || h == 0; }
+
+    T *data() { return buffer.data(); }
+    const T *data() const { return buffer.data(); }
+    T *row(int y) { return buffer.data() + y * s; }
+    const T *row(int y) const { return buffer.data() + y * s; }
+    T &at(int x, int y) { return buffer[y * s + x]; }
+    const T &at(int x, int y) const { return buffer[y * s + x]; }
+
+private:
+    // stride 取 per_line 的倍数，per_line 是字节数为 64 的倍数的最少元素个数；
+    // 元素大小不是 2 的幂时（如 3 字节的 Rgb888）per_line 为 64，每行起始地址仍然对齐
+    static std::ptrdiff_t aligned_stride(int width) {
+        const std::size_t alignment = AlignedAllocator<T>::alignment;
+        const std::ptrdiff_t per_line = alignment / std::gcd(alignment, sizeof(T));
+        return (width + per_line - 1) / per_line * per_line;
+    }
+
+    int w = 0;
+    int h = 0;
+    std::ptrdiff_t s = 0;
+    std::vector<T, AlignedAllocator<T>> buffer;
+};
+
+// QImage 与 Plane 之间的转换，只在对外接口处使用
+void image_to_plane(const QImage &image, Plane<QRgb> &output);
+QImage plane_to_image(const Plane<QRgb> &plane, QImage::Format format);
+
+template <typename T>
+void transpose(const Plane<T> &input, Plane<T> &output) {
+    SEAM_CARVER_TRACE_PIXELS("transpose", (long long) input.width() * input.height());
+    // 分块转置，使读写都保持在缓存内
+    const int block = 32;
+    output.resize(input.height(), input.width());
+    for (int y0 = 0; y0 < input.height(); y0 += block) {
+        const int y1 = std::min(y0 + block, input.height());
+        for (int x0 = 0; x0 < input.width(); x0 += block) {
+            const int x1 = std::min(x0 + block, input.width());
+            for (int y = y0; y < y1; y++) {
+                const T *src = input.row(y);
+                for (int x = x0; x < x1; x++) {
+                    output.at(y, x) = src[x];
+                }
+            }
+        }
+    }
+}
+
+#endif // IMAGE_PLANE_H
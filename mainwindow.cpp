@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "preview_proxy.h"
 
 #include <QApplication>
 #include <QLayout>
@@ -7,7 +8,8 @@
 #include <QPixmap>
 #include <QMessageBox>
 #include <QCheckBox>
-#include <QTimer>
+#include <QGuiApplication>
+#include <QScreen>
 
 #include <vector>
 
@@ -37,6 +39,9 @@ MainWindow::MainWindow(QWidget *parent)
     QPushButton *reset_button = new QPushButton("Reset", functional_area_widget);
     QPushButton *clean_button = new QPushButton("Clean", functional_area_widget);
     QCheckBox *energy_checkbox = new QCheckBox("Energy", functional_area_widget);
+    QCheckBox *preview_checkbox = new QCheckBox("Preview", functional_area_widget);
+    QCheckBox *enlarge_checkbox = new QCheckBox("Enlarge", functional_area_widget);
+    cancel_button = new QPushButton("Cancel", functional_area_widget);
     seam_width_spinbox = new QSpinBox(functional_area_widget);
     seam_button = new QPushButton("Seam", functional_area_widget);
     operator_combobox = new QComboBox(functional_area_widget);
@@ -50,11 +55,14 @@ MainWindow::MainWindow(QWidget *parent)
     operator_combobox->addItem("Prewitt");
     operator_combobox->addItem("Scharr");
     operator_combobox->addItem("Roberts");
+    operator_combobox->addItem("HoG");
+    operator_combobox->addItem("Entropy");
     operator_combobox->addItem("Forward");
     operator_combobox->setCurrentIndex(0);
 
     direction_combobox->addItem("Vertical");
     direction_combobox->addItem("Horizontal");
+    direction_combobox->addItem("Both");
     direction_combobox->setCurrentIndex(0);
 
     step_combobox->addItem("By pixels");
@@ -62,12 +70,18 @@ MainWindow::MainWindow(QWidget *parent)
     step_combobox->setCurrentIndex(0);
 
     energy_checkbox->setCheckState(Qt::Unchecked);
+    preview_checkbox->setCheckState(Qt::Unchecked);
+    enlarge_checkbox->setCheckState(Qt::Unchecked);
+    cancel_button->setEnabled(false);
 
     open_button->setStyleSheet(normal_button_stylesheet);
     save_button->setStyleSheet(normal_button_stylesheet);
     reset_button->setStyleSheet(normal_button_stylesheet);
     clean_button->setStyleSheet(normal_button_stylesheet);
     energy_checkbox->setStyleSheet(normal_button_stylesheet);
+    preview_checkbox->setStyleSheet(normal_button_stylesheet);
+    enlarge_checkbox->setStyleSheet(normal_button_stylesheet);
+    cancel_button->setStyleSheet(normal_button_stylesheet);
     seam_button->setStyleSheet(stress_button_stylesheet);
     QString merged_spinbox_stylesheet = seam_width_spinbox->styleSheet() + spinbox_stylesheet;
     seam_width_spinbox->setStyleSheet(merged_spinbox_stylesheet);
@@ -81,8 +95,11 @@ MainWindow::MainWindow(QWidget *parent)
     connect(reset_button, SIGNAL(clicked()), this, SLOT(on_reset_button_clicked()));
     connect(clean_button, SIGNAL(clicked()), this, SLOT(on_clean_button_clicked()));
     connect(energy_checkbox, &QCheckBox::stateChanged, this, &MainWindow::on_energy_checkbox_changed);
+    connect(preview_checkbox, &QCheckBox::stateChanged, this, &MainWindow::on_preview_checkbox_changed);
+    connect(enlarge_checkbox, &QCheckBox::stateChanged, this, &MainWindow::on_enlarge_checkbox_changed);
     connect(seam_width_spinbox, SIGNAL(valueChanged(int)), this, SLOT(on_seam_spinbox_changed(int)));
     connect(seam_button, SIGNAL(clicked()), this, SLOT(on_seam_button_clicked()));
+    connect(cancel_button, SIGNAL(clicked()), this, SLOT(on_cancel_button_clicked()));
 
     QGridLayout *operation_layout = new QGridLayout(functional_area_widget);
     functional_area_widget->setLayout(operation_layout);
@@ -90,7 +107,8 @@ MainWindow::MainWindow(QWidget *parent)
     functional_widgets = {
         open_button, save_button, reset_button,
         clean_button, energy_checkbox, seam_width_spinbox,
-        seam_button, operator_combobox, direction_combobox
+        seam_button, operator_combobox, direction_combobox,
+        preview_checkbox, enlarge_checkbox
     };
 
     operation_layout->addWidget(open_button, 0, 0);
@@ -105,6 +123,11 @@ MainWindow::MainWindow(QWidget *parent)
     operation_layout->addWidget(seam_width_spinbox, 1, 3);
     operation_layout->addWidget(seam_button, 1, 4);
 
+    operation_layout->addWidget(preview_checkbox, 2, 0);
+    operation_layout->addWidget(enlarge_checkbox, 2, 1);
+    // Cancel 只在后台缩放时可用，不放入 functional_widgets
+    operation_layout->addWidget(cancel_button, 2, 4);
+
     const int operation_widget_width = button_width * n_buttons_line;
     const int operation_widget_height = button_height * (functional_widgets.size() / n_buttons_line + 1);
 
@@ -141,10 +164,7 @@ MainWindow::on_open_button_clicked() {
     }
 
     original_image = QImage(fileName);
-    modified_image = QImage(fileName);
-
-    auto original_pixmap = QPixmap::fromImage(original_image);
-    auto modified_pixmap = QPixmap::fromImage(modified_image);
+    modified_image = original_image;
 
     // 记录缩放比例 scale_factor = 窗口宽度（高度） / 原图像宽度（高度）
     double label_ratio = (double) original_label->width() / (double) original_label->height();
@@ -185,12 +205,33 @@ MainWindow::on_clean_button_clicked() {
 void
 MainWindow::on_energy_checkbox_changed(const int state) {
     energy_toggled = state == Qt::Checked;
+    if (carve_worker != nullptr) {
+        carve_worker->set_energy(energy_toggled);
+    }
     show_modified();
 }
 
+void
+MainWindow::on_preview_checkbox_changed(const int state) {
+    preview_toggled = state == Qt::Checked;
+    if (preview_toggled) {
+        show_preview();
+    } else {
+        show_modified();
+    }
+}
+
+void
+MainWindow::on_enlarge_checkbox_changed(const int state) {
+    enlarge_toggled = state == Qt::Checked;
+}
+
 void
 MainWindow::on_seam_spinbox_changed(const int value) {
     n_seam_width = value;
+    if (preview_toggled) {
+        show_preview();
+    }
 }
 
 void
@@ -198,53 +239,115 @@ MainWindow::on_seam_button_clicked() {
     if (modified_image.isNull()) {
         return;
     }
+    if (direction_combobox->currentText() == "Both") {
+        carve_both();
+        return;
+    }
 
-    int seam_pixels;
-    if (step_combobox->currentText() == "By pixels") {
-        seam_pixels = seam_width_spinbox->value();
-    } else if (step_combobox->currentText() == "By ratio") {
-        if (direction_combobox->currentText() == "Vertical") {
-            seam_pixels = (int) ((double) seam_width_spinbox->value() / 100.0 * modified_image.width());
-        } else if (direction_combobox->currentText() == "Horizontal") {
-            seam_pixels = (int) ((double) seam_width_spinbox->value() / 100.0 * modified_image.height());
+    int seam_pixels = requested_seams();
+    if (seam_pixels < 0) {
+        return;
+    }
+
+    // 预览模式下直接按 seam 移除顺序得到结果，移除顺序还在后台计算时等它完成
+    if (!enlarge_toggled && preview_toggled) {
+        if (ensure_seam_map()) {
+            apply_seam_map(seam_pixels);
+            return;
         }
+        if (seam_map_worker != nullptr) {
+            seam_map_pending = seam_pixels;
+            return;
+        }
+    }
+
+    if (enlarge_toggled) {
+        seam_pixels = -seam_pixels;
+    }
+    if (direction_combobox->currentText() == "Horizontal") {
+        start_carving(modified_image.width(), modified_image.height() - seam_pixels);
     } else {
+        start_carving(modified_image.width() - seam_pixels, modified_image.height());
+    }
+}
+
+// 同时改变宽度和高度：By pixels 时两个方向各 n 个像素，By ratio 时各 n%
+// 缩小时由 Retarget2D 决定竖直与水平 seam 的先后顺序
+void
+MainWindow::carve_both() {
+    int delta_width = seam_width_spinbox->value();
+    int delta_height = seam_width_spinbox->value();
+    if (step_combobox->currentText() == "By ratio") {
+        delta_width = (int) ((double) seam_width_spinbox->value() / 100.0 * modified_image.width());
+        delta_height = (int) ((double) seam_width_spinbox->value() / 100.0 * modified_image.height());
+    }
+    if (enlarge_toggled) {
+        delta_width = -delta_width;
+        delta_height = -delta_height;
+    }
+    start_carving(modified_image.width() - delta_width, modified_image.height() - delta_height);
+}
+
+// 在后台线程中把 modified_image 缩放到目标尺寸，期间只有 Cancel 按钮可用
+void
+MainWindow::start_carving(int target_width, int target_height) {
+    if (carve_worker != nullptr || seam_map_worker != nullptr) {
         return;
     }
+    set_busy(true);
+    seam_button->setText("...");
+
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    current_kernels(kernelX, kernelY, window);
+    carve_worker = new CarveWorker(modified_image, kernelX, kernelY, window, target_width, target_height, this);
+    carve_worker->set_energy(energy_toggled);
+    carve_worker->set_preview_scale(scale_factor);
+    carve_worker->set_frame_interval(refresh_interval());
+    connect(carve_worker, &CarveWorker::progress, this, &MainWindow::on_carve_progress);
+    connect(carve_worker, &CarveWorker::carved, this, &MainWindow::on_carve_finished);
+    connect(carve_worker, &QThread::finished, carve_worker, &QObject::deleteLater);
+    carve_worker->start();
+}
 
-    for (int i = 0; i < functional_widgets.size(); i++) {
-        functional_widgets[i]->setEnabled(false);
+void
+MainWindow::on_carve_progress(const QImage &preview, const QImage &energy, int done, int total) {
+    seam_button->setText(QString::number(done) + "/" + QString::number(total));
+    // 中间结果只用于显示，modified_image 在完成时才更新
+    show_image(modified_label, energy_toggled && !energy.isNull() ? energy : preview, qMin(scale_factor, 1.0));
+    if (carve_worker != nullptr) {
+        carve_worker->frame_shown();
     }
-    for (int i = 0; i < seam_pixels; i++) {
-        seam_button->setText(QString::number(i + 1) + "/" + QString::number(seam_pixels));
+}
 
-        last_operator = operator_combobox->currentText();
-        if (operator_combobox->currentText() == "Forward") {
-            if (direction_combobox->currentText() == "Vertical") {
-                seam_carve_forward(modified_image, modified_image_energy);
-            } else if (direction_combobox->currentText() == "Horizontal") {
-                seam_carve_forward_horizontally(modified_image, modified_image_energy);
-            } else {
-                break;
-            }
-        }
-        else {
-            const Kernel *kernelX = name2kernel[operator_combobox->currentText()].first;
-            const Kernel *kernelY = name2kernel[operator_combobox->currentText()].second;
-            if (direction_combobox->currentText() == "Vertical") {
-                seam_carve(modified_image, modified_image_energy, *kernelX, *kernelY);
-            } else if (direction_combobox->currentText() == "Horizontal") {
-                seam_carve_horizontally(modified_image, modified_image_energy, *kernelX, *kernelY);
-            } else {
-                break;
-            }
-        }
+void
+MainWindow::on_carve_finished(const QImage &image, const QImage &energy, bool cancelled) {
+    Q_UNUSED(cancelled);
+    carve_worker = nullptr;
+    set_modified(image, energy);
+    set_busy(false);
+    show_modified();
+}
 
-        show_modified();
+void
+MainWindow::on_cancel_button_clicked() {
+    if (carve_worker != nullptr) {
+        carve_worker->cancel();
     }
-    seam_button->setText("Seam");
+    if (seam_map_worker != nullptr) {
+        seam_map_worker->cancel();
+    }
+}
+
+// 后台运行期间只有 Cancel 按钮可用
+void MainWindow::set_busy(bool busy) {
     for (int i = 0; i < functional_widgets.size(); i++) {
-        functional_widgets[i]->setEnabled(true);
+        functional_widgets[i]->setEnabled(!busy);
+    }
+    cancel_button->setEnabled(busy);
+    if (!busy) {
+        seam_button->setText("Seam");
     }
 }
 
@@ -260,22 +363,124 @@ void MainWindow::on_step_combobox_changed(const QString &text) {
     }
 }
 
+// 当前算子对应的卷积核与窗口能量，Forward 时卷积核为空
+void MainWindow::current_kernels(const Kernel *&kernelX, const Kernel *&kernelY, WindowEnergy &window) {
+    kernelX = nullptr;
+    kernelY = nullptr;
+    window = name2window.value(operator_combobox->currentText(), WindowEnergy::None);
+    if (operator_combobox->currentText() != "Forward") {
+        kernelX = name2kernel[operator_combobox->currentText()].first;
+        kernelY = name2kernel[operator_combobox->currentText()].second;
+    }
+}
+
+// 根据 step_combobox 与 spinbox 计算需要移除的 seam 数，无法确定时返回 -1
+int MainWindow::requested_seams() {
+    int seam_pixels = -1;
+    if (step_combobox->currentText() == "By pixels") {
+        seam_pixels = seam_width_spinbox->value();
+    } else if (step_combobox->currentText() == "By ratio") {
+        if (direction_combobox->currentText() == "Vertical") {
+            seam_pixels = (int) ((double) seam_width_spinbox->value() / 100.0 * modified_image.width());
+        } else if (direction_combobox->currentText() == "Horizontal") {
+            seam_pixels = (int) ((double) seam_width_spinbox->value() / 100.0 * modified_image.height());
+        }
+    }
+    return seam_pixels;
+}
+
+// 图像、算子或方向改变后在后台重新计算 seam 移除顺序（一次性缩到最小），之后的预览只需过滤像素
+// 移除顺序可用时返回 true；否则开始计算并返回 false，完成后由 on_seam_map_built 刷新预览
+bool MainWindow::ensure_seam_map() {
+    // 同时缩放两个方向时没有单一的移除顺序
+    if (modified_image.isNull() || direction_combobox->currentText() == "Both") {
+        return false;
+    }
+    const QString config = operator_combobox->currentText() + "/" + direction_combobox->currentText();
+    if (!seam_map.isNull() && seam_map_image_key == modified_image.cacheKey() && seam_map_config == config) {
+        return true;
+    }
+    if (seam_map_worker != nullptr || carve_worker != nullptr) {
+        return false;
+    }
+
+    // 计算期间界面被禁用，图像与设置不会改变，结果直接对应这里记录的图像和设置
+    seam_map = SeamMap();
+    seam_map_image_key = modified_image.cacheKey();
+    seam_map_config = config;
+    set_busy(true);
+    seam_button->setText("Map");
+
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    current_kernels(kernelX, kernelY, window);
+    const bool horizontal = direction_combobox->currentText() == "Horizontal";
+    seam_map_worker = new SeamMapWorker(modified_image, kernelX, kernelY, window, horizontal, this);
+    connect(seam_map_worker, &SeamMapWorker::progress, this, &MainWindow::on_seam_map_progress);
+    connect(seam_map_worker, &SeamMapWorker::built, this, &MainWindow::on_seam_map_built);
+    connect(seam_map_worker, &QThread::finished, seam_map_worker, &QObject::deleteLater);
+    seam_map_worker->start();
+    return false;
+}
+
+void
+MainWindow::on_seam_map_progress(int done, int total) {
+    seam_button->setText("Map " + QString::number(done) + "/" + QString::number(total));
+}
+
+// 取消时不保留移除顺序，也不执行等待中的移除
+void
+MainWindow::on_seam_map_built(const SeamMap &map, bool cancelled) {
+    seam_map_worker = nullptr;
+    seam_map = map;
+    const int pending = seam_map_pending;
+    seam_map_pending = -1;
+    set_busy(false);
+    if (cancelled) {
+        show_modified();
+    } else if (pending >= 0) {
+        apply_seam_map(pending);
+    } else if (preview_toggled) {
+        show_preview();
+    }
+}
+
+// 按移除顺序把 modified_image 缩小 seam_pixels 列（行）
+void MainWindow::apply_seam_map(int seam_pixels) {
+    const int size = seam_map.horizontal ? modified_image.height() : modified_image.width();
+    modified_image = retarget_with_seam_map(modified_image, seam_map, size - seam_pixels);
+    show_modified();
+}
+
+void MainWindow::show_preview() {
+    int seam_pixels = requested_seams();
+    if (seam_pixels < 0 || !ensure_seam_map()) {
+        return;
+    }
+    const int size = seam_map.horizontal ? modified_image.height() : modified_image.width();
+    show_image(modified_label, retarget_with_seam_map(modified_image, seam_map, size - seam_pixels));
+}
+
 // 显示修改后的图片（根据是否勾选 energy checkbox 进行调整）
 void MainWindow::show_modified() {
     if (energy_toggled) {
         if (
             modified_image_energy.isNull() ||
-            modified_image_energy.width() != modified_image.width() ||
-            modified_image_energy.height() != modified_image.height() ||
-            last_operator != operator_combobox->currentText()
+            energy_image_key != modified_image.cacheKey() ||
+            energy_config != energy_settings()
         ) {
+            const bool horizontal = direction_combobox->currentText() == "Horizontal";
             if (operator_combobox->currentText() == "Forward") {
-                calc_energy_forward(modified_image, modified_image_energy);
+                calc_energy_forward(modified_image, modified_image_energy, horizontal);
             } else {
                 const Kernel *kernelX = name2kernel[operator_combobox->currentText()].first;
                 const Kernel *kernelY = name2kernel[operator_combobox->currentText()].second;
-                calc_energy_conv(modified_image, modified_image_energy, *kernelX, *kernelY);
+                const WindowEnergy window = name2window.value(operator_combobox->currentText(), WindowEnergy::None);
+                calc_energy_conv(modified_image, modified_image_energy, *kernelX, *kernelY, window);
             }
+            energy_image_key = modified_image.cacheKey();
+            energy_config = energy_settings();
         }
         // if (operator_combobox->currentText() == "Forward") {
         //     calc_energy_forward(modified_image, modified_image_energy);
@@ -290,17 +495,50 @@ void MainWindow::show_modified() {
     }
 }
 
-void MainWindow::show_image(QLabel *label, QImage image) {
-    QPixmap pixmap = QPixmap::fromImage(image);
-    label->setPixmap(pixmap.scaled((int)(scale_factor * image.width()),
-                                    (int)(scale_factor * image.height()),
-                                    Qt::KeepAspectRatio));
+// 能量图依赖的设置：算子与方向（前向能量在水平方向上不同）
+QString MainWindow::energy_settings() {
+    return operator_combobox->currentText() + "/" + direction_combobox->currentText();
+}
+
+// 后台线程发来的图像；energy 不为空时是按当前设置计算的同一图像的能量图，直接作为缓存
+void MainWindow::set_modified(const QImage &image, const QImage &energy) {
+    modified_image = image;
+    if (!energy.isNull()) {
+        modified_image_energy = energy;
+        energy_image_key = modified_image.cacheKey();
+        energy_config = energy_settings();
+    }
+}
+
+// image 的尺寸为原尺寸的 image_scale 倍
+// 需要缩小时先在 QImage 上按区域平均缩到显示尺寸，只把显示尺寸的图像转换为 QPixmap；放大才缩放 QPixmap
+void MainWindow::show_image(QLabel *label, const QImage &image, double image_scale) {
+    const double ratio = scale_factor / image_scale;
+    QPixmap pixmap = QPixmap::fromImage(ratio < 1 ? preview_image(image, ratio) : image);
+    if (ratio > 1) {
+        pixmap = pixmap.scaled((int)(ratio * image.width()),
+                               (int)(ratio * image.height()),
+                               Qt::KeepAspectRatio);
+    }
+    label->setPixmap(pixmap);
     label->setAlignment(Qt::AlignCenter);
     label->show();
-    update();
-    QEventLoop loop;
-    QTimer::singleShot(10, &loop, SLOT(quit()));
-    loop.exec();
 }
 
-MainWindow::~MainWindow() {}
+// 屏幕刷新间隔（毫秒），预览不需要比它更频繁地重绘
+int MainWindow::refresh_interval() {
+    QScreen *screen = QGuiApplication::primaryScreen();
+    const qreal rate = screen != nullptr ? screen->refreshRate() : 0;
+    return rate > 0 ? qMax(1, (int) (1000 / rate)) : CarveWorker::default_frame_interval;
+}
+
+MainWindow::~MainWindow() {
+    if (carve_worker != nullptr) {
+        carve_worker->cancel();
+        carve_worker->wait();
+    }
+    if (seam_map_worker != nullptr) {
+        seam_map_worker->cancel();
+        seam_map_worker->wait();
+    }
+}
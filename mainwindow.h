@@ -2,6 +2,9 @@
 #define MAINWINDOW_H
 
 #include "seam_carver.h"
+#include "seam_map.h"
+#include "carve_worker.h"
+#include "seam_map_worker.h"
 
 #include <QMainWindow>
 #include <QLabel>
@@ -26,16 +29,23 @@ private:
         {"Sobel", {&SobelX, &SobelY}},
         {"Prewitt", {&PrewittX, &PrewittY}},
         {"Scharr", {&ScharrX, &ScharrY}},
-        {"Roberts", {&RobertsX, &RobertsY}}
+        {"Roberts", {&RobertsX, &RobertsY}},
+        {"HoG", {&SobelX, &SobelY}},
+        {"Entropy", {&SobelX, &SobelY}}
+    };
+    // 在卷积核之外另加窗口能量的算子，其余算子为 WindowEnergy::None
+    QMap <const QString, WindowEnergy> name2window{
+        {"HoG", WindowEnergy::HoG},
+        {"Entropy", WindowEnergy::Entropy}
     };
     const QString normal_button_stylesheet = "QPushButton { height: 30px; border-radius: 5px; background-color: white; border: 1px solid grey; }";
     const QString stress_button_stylesheet = "QPushButton { height: 30px; border-radius: 5px; background-color: #8764B8; color: white; }";
     const QString combobox_stylesheet = "height: 30px;";
     // const QString combobox_stylesheet = "QComboBox { height: 30px; border-radius: 5px; background-color: white; border: 1px solid grey; }";
     const QString spinbox_stylesheet = "height: 30px;";
-    QString last_operator = "";
 
     QPushButton *seam_button;
+    QPushButton *cancel_button;
     QSpinBox *seam_width_spinbox;
     QComboBox *operator_combobox;
     QComboBox *direction_combobox;
@@ -44,16 +54,42 @@ private:
     QLabel *modified_label;
     QImage original_image;
     QImage modified_image;
+    // 正则化后的能量图只用于显示，在勾选 Energy 时才计算，
+    // 并缓存到图像（cacheKey）、算子或方向改变为止
     QImage modified_image_energy;
+    qint64 energy_image_key = 0;
+    QString energy_config;
     // 缩放比例 = 窗口宽度 / 原图像宽度
     // 用于在比较原图片和修改后的图片时保持缩放比例一致
     std::vector<QWidget *> functional_widgets;
     double scale_factor;
     int n_seam_width;
     bool energy_toggled = false;
+    bool preview_toggled = false;
+    bool enlarge_toggled = false;
+    // 预览用的 seam 移除顺序，以及它对应的图像（cacheKey）和算子、方向
+    SeamMap seam_map;
+    qint64 seam_map_image_key = 0;
+    QString seam_map_config;
+    // 正在后台计算的移除顺序，没有时为空；seam_map_pending >= 0 时计算完成后按它移除 seam
+    SeamMapWorker *seam_map_worker = nullptr;
+    int seam_map_pending = -1;
+    // 正在后台运行的缩放，没有时为空
+    CarveWorker *carve_worker = nullptr;
 
     void show_modified();
-    void show_image(QLabel *label, QImage image);
+    QString energy_settings();
+    void set_modified(const QImage &image, const QImage &energy);
+    void show_image(QLabel *label, const QImage &image, double image_scale = 1.0);
+    int refresh_interval();
+    void current_kernels(const Kernel *&kernelX, const Kernel *&kernelY, WindowEnergy &window);
+    int requested_seams();
+    bool ensure_seam_map();
+    void apply_seam_map(int seam_pixels);
+    void set_busy(bool busy);
+    void show_preview();
+    void carve_both();
+    void start_carving(int target_width, int target_height);
 
 private slots:
     void on_open_button_clicked();
@@ -61,8 +97,15 @@ private slots:
     void on_reset_button_clicked();
     void on_clean_button_clicked();
     void on_energy_checkbox_changed(const int state);
+    void on_preview_checkbox_changed(const int state);
+    void on_enlarge_checkbox_changed(const int state);
     void on_seam_spinbox_changed(const int value);
     void on_seam_button_clicked();
     void on_step_combobox_changed(const QString &text);
+    void on_cancel_button_clicked();
+    void on_carve_progress(const QImage &preview, const QImage &energy, int done, int total);
+    void on_carve_finished(const QImage &image, const QImage &energy, bool cancelled);
+    void on_seam_map_progress(int done, int total);
+    void on_seam_map_built(const SeamMap &map, bool cancelled);
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,125 @@
+#include "pixel_plane.h"
+#include "worker_pool.h"
+#include "trace.h"
+
+#include <cstring>
+
+// 灰度按水平条带并行计算时每个线程至少处理的像素数
+static const int gray_grain_pixels = 64 * 1024;
+
+template <typename P>
+static void copy_rows(const QImage &image, Plane<P> &plane) {
+    plane.resize(image.width(), image.height());
+    for (int y = 0; y < image.height(); y++) {
+        std::memcpy(plane.row(y), image.constScanLine(y), image.width() * sizeof(P));
+    }
+}
+
+PixelPlane::PixelPlane(const QImage &image) : source_format(image.format()), w(image.width()), h(image.height()) {
+    switch (image.format()) {
+    case QImage::Format_Grayscale8:
+        plane_format = QImage::Format_Grayscale8;
+        copy_rows(image, planes.emplace<Plane<uchar>>());
+        break;
+    case QImage::Format_RGB888:
+        plane_format = QImage::Format_RGB888;
+        copy_rows(image, planes.emplace<Plane<Rgb888>>());
+        break;
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+        plane_format = image.format();
+        copy_rows(image, planes.emplace<Plane<QRgb>>());
+        break;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    case QImage::Format_RGBX64:
+    case QImage::Format_RGBA64:
+        plane_format = image.format();
+        copy_rows(image, planes.emplace<Plane<QRgba64>>());
+        break;
+    // 无损地展开为 16 位 RGB
+    case QImage::Format_Grayscale16:
+        plane_format = QImage::Format_RGBX64;
+        copy_rows(image.convertToFormat(plane_format), planes.emplace<Plane<QRgba64>>());
+        break;
+    // 预乘的 alpha 先还原，与 8 位的预乘格式相同
+    case QImage::Format_RGBA64_Premultiplied:
+        plane_format = QImage::Format_RGBA64;
+        copy_rows(image.convertToFormat(plane_format), planes.emplace<Plane<QRgba64>>());
+        break;
+#endif
+    default:
+        plane_format = QImage::Format_ARGB32;
+        copy_rows(image.convertToFormat(plane_format), planes.emplace<Plane<QRgb>>());
+        break;
+    }
+}
+
+PixelPlane PixelPlane::blank(int width, int height) const {
+    PixelPlane output;
+    output.plane_format = plane_format;
+    output.source_format = source_format;
+    output.w = width;
+    output.h = height;
+    visit([&](const auto &plane) {
+        typedef plane_pixel_t<decltype(plane)> P;
+        output.planes.emplace<Plane<P>>(width, height);
+    });
+    return output;
+}
+
+QImage PixelPlane::to_image() const {
+    QImage image(width(), height(), plane_format);
+    visit([&](const auto &plane) {
+        typedef plane_pixel_t<decltype(plane)> P;
+        for (int y = 0; y < plane.height(); y++) {
+            std::memcpy(image.scanLine(y), plane.row(y), plane.width() * sizeof(P));
+        }
+    });
+    if (source_format != plane_format && source_format != QImage::Format_Invalid) {
+        return image.convertToFormat(source_format);
+    }
+    return image;
+}
+
+QImage::Format PixelPlane::format() const {
+    return source_format;
+}
+
+void PixelPlane::gray(Plane<uchar> &output) const {
+    SEAM_CARVER_TRACE_PIXELS("rgb2gray", (long long) width() * height());
+    visit([&](const auto &plane) {
+        output.resize(plane.width(), plane.height());
+        const int grain = qMax(1, gray_grain_pixels / qMax(1, plane.width()));
+        WorkerPool::global().parallel_for(0, plane.height(), grain, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                const auto *line = plane.row(y);
+                uchar *g = output.row(y);
+                for (int x = 0; x < plane.width(); x++) {
+                    g[x] = pixel_gray(line[x]);
+                }
+            }
+        });
+    });
+}
+
+void PixelPlane::remove_seam(const std::vector<int> &seam, bool horizontal) {
+    visit([&](auto &plane) {
+        if (horizontal) {
+            ::remove_horizontal_seam(plane, seam);
+        } else {
+            ::remove_seam(plane, seam);
+        }
+    });
+    (horizontal ? h : w)--;
+}
+
+void PixelPlane::remove_seams(const std::vector<int> &positions, int k, bool horizontal) {
+    visit([&](auto &plane) {
+        if (horizontal) {
+            ::remove_horizontal_seams(plane, positions, k);
+        } else {
+            ::remove_seams(plane, positions, k);
+        }
+    });
+    (horizontal ? h : w) -= k;
+}
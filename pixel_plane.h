@@ -0,0 +1,133 @@
+#ifndef PIXEL_PLANE_H
+#define PIXEL_PLANE_H
+
+#include "image_plane.h"
+#include "seam_carver.h"
+
+#include <QImage>
+#include <QRgba64>
+
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// QImage::Format_RGB888 的一个像素，按内存中的字节顺序
+struct Rgb888 {
+    uchar r;
+    uchar g;
+    uchar b;
+};
+static_assert(sizeof(Rgb888) == 3, "Rgb888 must match the packed RGB888 layout");
+
+// 各像素类型的 8 位灰度，权重与 qGray 相同；16 位像素先以 16 位计算再舍入到 8 位
+inline uchar pixel_gray(uchar p) {
+    return p;
+}
+
+inline uchar pixel_gray(Rgb888 p) {
+    return qGray(p.r, p.g, p.b);
+}
+
+inline uchar pixel_gray(QRgb p) {
+    return qGray(p);
+}
+
+inline uchar pixel_gray(QRgba64 p) {
+    const uint gray = (p.red() * 11u + p.green() * 16u + p.blue() * 5u) / 32u;
+    return (gray + 128) / 257;
+}
+
+// 两个像素逐通道的平均，用于插入 seam
+inline uchar pixel_average(uchar a, uchar b) {
+    return (a + b + 1) / 2;
+}
+
+inline Rgb888 pixel_average(Rgb888 a, Rgb888 b) {
+    return {pixel_average(a.r, b.r), pixel_average(a.g, b.g), pixel_average(a.b, b.b)};
+}
+
+inline QRgb pixel_average(QRgb a, QRgb b) {
+    return qRgba(
+        (qRed(a) + qRed(b) + 1) / 2, (qGreen(a) + qGreen(b) + 1) / 2,
+        (qBlue(a) + qBlue(b) + 1) / 2, (qAlpha(a) + qAlpha(b) + 1) / 2
+    );
+}
+
+inline QRgba64 pixel_average(QRgba64 a, QRgba64 b) {
+    return QRgba64::fromRgba64(
+        (a.red() + b.red() + 1) / 2, (a.green() + b.green() + 1) / 2,
+        (a.blue() + b.blue() + 1) / 2, (a.alpha() + b.alpha() + 1) / 2
+    );
+}
+
+// 转换为 8 位 ARGB，只用于显示
+inline QRgb pixel_argb(uchar p) {
+    return qRgb(p, p, p);
+}
+
+inline QRgb pixel_argb(Rgb888 p) {
+    return qRgb(p.r, p.g, p.b);
+}
+
+inline QRgb pixel_argb(QRgb p) {
+    return p;
+}
+
+inline QRgb pixel_argb(QRgba64 p) {
+    return p.toArgb32();
+}
+
+// 按 QImage 格式选定一次像素类型的像素平面
+// Grayscale8 每像素 1 字节，RGB888 3 字节，RGB32/ARGB32 4 字节，16 位格式（RGBX64/RGBA64/Grayscale16）8 字节，
+// 其余格式转换为 ARGB32 后处理。移除与插入 seam 只搬运原格式的像素，16 位精度与 alpha 不会丢失；
+// 各操作通过 visit() 在具体的 Plane<P> 上实例化，循环内没有按像素的格式分支
+class PixelPlane
+{
+public:
+    typedef std::variant<Plane<uchar>, Plane<Rgb888>, Plane<QRgb>, Plane<QRgba64>> Planes;
+
+    PixelPlane() = default;
+    explicit PixelPlane(const QImage &image);
+
+    // 以相同的像素类型与格式生成 width x height 的平面，内容为零
+    PixelPlane blank(int width, int height) const;
+
+    // 转换回构造时的 QImage 格式
+    QImage to_image() const;
+    QImage::Format format() const;
+
+    int width() const { return w; }
+    int height() const { return h; }
+
+    // 8 位灰度图，用于计算能量
+    void gray(Plane<uchar> &output) const;
+
+    // 原地移除 seam，参数与 remove_seam / remove_seams 及其水平版本相同
+    void remove_seam(const std::vector<int> &seam, bool horizontal);
+    void remove_seams(const std::vector<int> &positions, int k, bool horizontal);
+
+    // 以具体的 Plane<P> 调用 f
+    template <typename F>
+    decltype(auto) visit(F &&f) { return std::visit(std::forward<F>(f), planes); }
+    template <typename F>
+    decltype(auto) visit(F &&f) const { return std::visit(std::forward<F>(f), planes); }
+
+    // 与 visit 得到的平面类型相同的另一个平面
+    template <typename P>
+    Plane<P> &get() { return std::get<Plane<P>>(planes); }
+
+private:
+    Planes planes;
+    // planes 中各行的实际格式与构造时的格式
+    QImage::Format plane_format = QImage::Format_Invalid;
+    QImage::Format source_format = QImage::Format_Invalid;
+    int w = 0;
+    int h = 0;
+};
+
+// Plane<P> 中的像素类型
+template <typename PlaneType>
+using plane_pixel_t = typename std::decay_t<decltype(*std::declval<PlaneType &>().data())>;
+
+#endif // PIXEL_PLANE_H
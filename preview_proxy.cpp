@@ -0,0 +1,124 @@
+#include "preview_proxy.h"
+#include "pixel_plane.h"
+#include "trace.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+static int proxy_size(int size, double ratio) {
+    return qMax(1, (int) std::lround(size * ratio));
+}
+
+// 第 p 个预览像素覆盖原图的 [footprint_end(p - 1), footprint_end(p))，最后一个覆盖到原图边缘
+static int footprint_end(int p, int count, int size, double ratio) {
+    return p == count - 1 ? size : (int) ((p + 1) / ratio);
+}
+
+// 覆盖范围在 changed 之前、并且与上一次相同的预览像素个数
+static int unchanged_prefix(int changed, int old_size, int new_size, double ratio) {
+    const int old_count = proxy_size(old_size, ratio);
+    const int new_count = proxy_size(new_size, ratio);
+    int p = 0;
+    while (p < qMin(old_count, new_count)) {
+        const int end = footprint_end(p, new_count, new_size, ratio);
+        if (end > changed || end != footprint_end(p, old_count, old_size, ratio)) {
+            break;
+        }
+        p++;
+    }
+    return p;
+}
+
+// 重新采样 output 中 px >= px0 或 py >= py0 的像素，其余像素保持不变
+// row(y) 返回原图第 y 行的像素，按像素类型实例化
+template <typename Row>
+static void resample(Row row, int width, int height, double ratio, QImage &output, int px0, int py0) {
+    SEAM_CARVER_TRACE_PIXELS("preview", (long long) width * height);
+    const int pw = output.width();
+    const int ph = output.height();
+    std::vector<int> xs(pw + 1, 0);
+    std::vector<int> ys(ph + 1, 0);
+    for (int p = 0; p < pw; p++) {
+        xs[p + 1] = footprint_end(p, pw, width, ratio);
+    }
+    for (int p = 0; p < ph; p++) {
+        ys[p + 1] = footprint_end(p, ph, height, ratio);
+    }
+
+    std::vector<quint32> sums((std::size_t) pw * 4);
+    for (int py = 0; py < ph; py++) {
+        const int first = py < py0 ? px0 : 0;
+        if (first >= pw) {
+            continue;
+        }
+        std::fill(sums.begin() + (std::size_t) first * 4, sums.end(), 0);
+        for (int y = ys[py]; y < ys[py + 1]; y++) {
+            const auto *line = row(y);
+            for (int px = first; px < pw; px++) {
+                quint32 *s = sums.data() + (std::size_t) px * 4;
+                for (int x = xs[px]; x < xs[px + 1]; x++) {
+                    const QRgb c = pixel_argb(line[x]);
+                    s[0] += qRed(c);
+                    s[1] += qGreen(c);
+                    s[2] += qBlue(c);
+                    s[3] += qAlpha(c);
+                }
+            }
+        }
+        QRgb *out = reinterpret_cast<QRgb *>(output.scanLine(py));
+        const int rows = ys[py + 1] - ys[py];
+        for (int px = first; px < pw; px++) {
+            const quint32 *s = sums.data() + (std::size_t) px * 4;
+            const quint32 n = rows * (xs[px + 1] - xs[px]);
+            out[px] = qRgba(s[0] / n, s[1] / n, s[2] / n, s[3] / n);
+        }
+    }
+}
+
+PreviewProxy::PreviewProxy(double scale) : ratio(scale > 0 && scale < 1 ? scale : 1.0) {}
+
+double PreviewProxy::scale() const {
+    return ratio;
+}
+
+void PreviewProxy::update(const PixelPlane &pixels, int changed_x, int changed_y) {
+    const int pw = proxy_size(pixels.width(), ratio);
+    const int ph = proxy_size(pixels.height(), ratio);
+    int px0 = 0;
+    int py0 = 0;
+    if (!proxy.isNull()) {
+        px0 = unchanged_prefix(changed_x, source_width, pixels.width(), ratio);
+        py0 = unchanged_prefix(changed_y, source_height, pixels.height(), ratio);
+    }
+    if (proxy.width() != pw || proxy.height() != ph) {
+        // 尺寸变化时只复制不变的左上角
+        QImage next(pw, ph, QImage::Format_ARGB32);
+        for (int py = 0; py < py0; py++) {
+            std::memcpy(next.scanLine(py), proxy.constScanLine(py), px0 * sizeof(QRgb));
+        }
+        proxy = next;
+    }
+    source_width = pixels.width();
+    source_height = pixels.height();
+    pixels.visit([&](const auto &plane) {
+        resample([&](int y) { return plane.row(y); }, plane.width(), plane.height(), ratio, proxy, px0, py0);
+    });
+}
+
+QImage PreviewProxy::image() const {
+    return proxy;
+}
+
+QImage preview_image(const QImage &image, double scale) {
+    if (image.isNull()) {
+        return QImage();
+    }
+    const double ratio = scale > 0 && scale < 1 ? scale : 1.0;
+    const QImage source = image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_RGB32
+        ? image : image.convertToFormat(QImage::Format_ARGB32);
+    QImage output(proxy_size(source.width(), ratio), proxy_size(source.height(), ratio), QImage::Format_ARGB32);
+    auto row = [&](int y) { return reinterpret_cast<const QRgb *>(source.constScanLine(y)); };
+    resample(row, source.width(), source.height(), ratio, output, 0, 0);
+    return output;
+}
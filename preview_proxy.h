@@ -0,0 +1,39 @@
+#ifndef PREVIEW_PROXY_H
+#define PREVIEW_PROXY_H
+
+#include "image_plane.h"
+
+#include <QImage>
+
+class PixelPlane;
+
+// 显示分辨率的预览图
+// 每个预览像素取它在原图中覆盖区域（[px / scale, (px + 1) / scale)）的平均值，比例固定，
+// 因此原图某一列（行）之前的像素不变时，对应的预览列（行）也不变，移除 seam 后只需重新采样变化的条带
+class PreviewProxy
+{
+public:
+    // scale 为预览与原图的尺寸比例，不小于 1 时按 1 处理，放大交给显示
+    explicit PreviewProxy(double scale = 1.0);
+
+    double scale() const;
+
+    // 原图变为 pixels，与上一次相比只有 x >= changed_x 的列或 y >= changed_y 的行可能改变
+    // 第一次调用或尺寸比例改变后整幅重新采样
+    void update(const PixelPlane &pixels, int changed_x, int changed_y);
+
+    // 与发送出去的副本隐式共享，下一次 update 时如果副本仍在使用才复制预览大小的数据
+    QImage image() const;
+
+private:
+    double ratio;
+    QImage proxy;
+    // 上一次的原图尺寸
+    int source_width = 0;
+    int source_height = 0;
+};
+
+// 把整幅图像按 PreviewProxy 的方式缩小到 scale 倍，只用于显示
+QImage preview_image(const QImage &image, double scale);
+
+#endif // PREVIEW_PROXY_H
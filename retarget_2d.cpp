@@ -0,0 +1,168 @@
+#include "retarget_2d.h"
+#include "carve_session.h"
+
+Retarget2D::Retarget2D(
+    const QImage &image,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window
+) : kernelX(kernelX), kernelY(kernelY), window(window), pixels(image) {
+    pixels.gray(gray);
+    if (forward()) {
+        return;
+    }
+    // 窗口能量与 seam 的方向无关，两个方向共用一张能量图
+    if (window != WindowEnergy::None) {
+        horizontalX = kernelX;
+        horizontalY = kernelY;
+    } else {
+        horizontal_kernels(*kernelX, *kernelY, transposedX, transposedY, horizontalX, horizontalY);
+    }
+    shared = horizontalX == kernelX && horizontalY == kernelY;
+    calc_energy_conv(gray, energy, *kernelX, *kernelY, window);
+    if (!shared) {
+        calc_energy_conv(gray, horizontal_energy, *horizontalX, *horizontalY);
+    }
+}
+
+bool Retarget2D::step(int target_width, int target_height) {
+    const bool allowed[2] = {width() > qMax(1, target_width), height() > qMax(1, target_height)};
+    if (!allowed[0] && !allowed[1]) {
+        return false;
+    }
+    while (true) {
+        bool horizontal = !allowed[0] || (allowed[1] && candidates[1].cost < candidates[0].cost);
+        if (!candidates[horizontal].valid) {
+            find_candidate(horizontal);
+            // 只剩一个方向可选时不需要比较
+            if (allowed[!horizontal]) {
+                continue;
+            }
+        }
+        remove(horizontal);
+        return true;
+    }
+}
+
+long long Retarget2D::removed_energy() const {
+    return removed;
+}
+
+int Retarget2D::vertical_seams() const {
+    return seams[0];
+}
+
+int Retarget2D::horizontal_seams() const {
+    return seams[1];
+}
+
+QImage Retarget2D::result() const {
+    return pixels.to_image();
+}
+
+const PixelPlane &Retarget2D::plane() const {
+    return pixels;
+}
+
+// 候选在过期后仍保留 seam，直到同一方向再次递推
+const std::vector<int> &Retarget2D::last_seam() const {
+    return candidates[last].seam;
+}
+
+bool Retarget2D::last_horizontal() const {
+    return last;
+}
+
+QImage Retarget2D::energy_image() const {
+    QImage output;
+    if (forward()) {
+        Plane<int> forward_energy;
+        calc_energy_forward(gray, forward_energy);
+        normalize(forward_energy, output);
+    } else {
+        normalize(energy, output);
+    }
+    return output;
+}
+
+int Retarget2D::width() const {
+    return pixels.width();
+}
+
+int Retarget2D::height() const {
+    return pixels.height();
+}
+
+bool Retarget2D::forward() const {
+    return kernelX == nullptr || kernelY == nullptr;
+}
+
+const Plane<int> &Retarget2D::energy_for(bool horizontal) const {
+    return horizontal && !shared ? horizontal_energy : energy;
+}
+
+void Retarget2D::find_candidate(bool horizontal) {
+    Candidate &candidate = candidates[horizontal];
+    if (forward()) {
+        candidate.seam = find_seam_forward(gray, horizontal);
+        candidate.cost = forward_seam_cost(gray, candidate.seam, horizontal);
+    } else {
+        const Plane<int> &e = energy_for(horizontal);
+        candidate.seam = find_seam(e, horizontal);
+        candidate.cost = 0;
+        for (int i = 0; i < (int) candidate.seam.size(); i++) {
+            candidate.cost += horizontal ? e.at(i, candidate.seam[i]) : e.at(candidate.seam[i], i);
+        }
+    }
+    candidate.valid = true;
+}
+
+void Retarget2D::remove(bool horizontal) {
+    const std::vector<int> &seam = candidates[horizontal].seam;
+    removed += candidates[horizontal].cost;
+    seams[horizontal]++;
+    last = horizontal;
+
+    std::vector<Plane<int> *> energies;
+    if (!forward()) {
+        energies.push_back(&energy);
+        if (!shared) {
+            energies.push_back(&horizontal_energy);
+        }
+    }
+    if (horizontal) {
+        pixels.remove_seam(seam, true);
+        remove_horizontal_seam(gray, seam);
+        for (Plane<int> *e : energies) {
+            remove_horizontal_seam(*e, seam);
+        }
+    } else {
+        pixels.remove_seam(seam, false);
+        remove_seam(gray, seam);
+        for (Plane<int> *e : energies) {
+            remove_seam(*e, seam);
+        }
+    }
+    if (!forward()) {
+        update_energy_band(gray, energy, *kernelX, *kernelY, window, seam, 1, horizontal);
+        if (!shared) {
+            update_energy_band(gray, horizontal_energy, *horizontalX, *horizontalY, WindowEnergy::None, seam, 1, horizontal);
+        }
+    }
+
+    // 两个候选都已过期，保留 cost 作为下一步比较时的估计
+    candidates[0].valid = false;
+    candidates[1].valid = false;
+}
+
+QImage retarget_2d(
+    const QImage &image, int width, int height,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    long long *removed
+) {
+    Retarget2D retarget(image, kernelX, kernelY, window);
+    while (retarget.step(width, height)) {
+    }
+    if (removed != nullptr) {
+        *removed = retarget.removed_energy();
+    }
+    return retarget.result();
+}
@@ -0,0 +1,81 @@
+#ifndef RETARGET_2D_H
+#define RETARGET_2D_H
+
+#include "seam_carver.h"
+#include "image_plane.h"
+#include "pixel_plane.h"
+
+#include <QImage>
+
+#include <vector>
+
+// 同时缩小宽度和高度，按贪心顺序交替移除竖直与水平 seam：
+// 每一步比较两个方向上能量最小的 seam，移除其中总能量较小的一条（Avidan & Shamir 中 transport map 的贪心近似）
+// 灰度图与能量图在两个方向之间共享（卷积核转置后能量不变时只有一张），每次移除后只更新窄带；
+// 另一方向的候选 seam 保留上次的能量作为估计，只有它再次成为较小者时才重新递推
+class Retarget2D
+{
+public:
+    // kernelX 与 kernelY 为空时使用前向能量；window 为 find_kernels 给出的窗口能量
+    Retarget2D(const QImage &image, const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window);
+
+    // 移除一条 seam，宽高都已不大于目标尺寸时返回 false
+    bool step(int target_width, int target_height);
+
+    // 已移除 seam 的能量之和
+    long long removed_energy() const;
+    int vertical_seams() const;
+    int horizontal_seams() const;
+
+    QImage result() const;
+    // 当前图像的像素（原格式），不复制
+    const PixelPlane &plane() const;
+    // 最近一次 step() 移除的 seam 及其方向
+    const std::vector<int> &last_seam() const;
+    bool last_horizontal() const;
+    // 正则化到 0~255 的竖直方向能量图，仅用于显示
+    QImage energy_image() const;
+
+    int width() const;
+    int height() const;
+
+private:
+    struct Candidate {
+        // seam 与 cost 对应当前图像；为 false 时 cost 只是移除另一方向 seam 之前的估计
+        bool valid = false;
+        long long cost = 0;
+        std::vector<int> seam;
+    };
+
+    const Kernel *kernelX;
+    const Kernel *kernelY;
+    WindowEnergy window;
+    Kernel transposedX;
+    Kernel transposedY;
+    const Kernel *horizontalX = nullptr;
+    const Kernel *horizontalY = nullptr;
+    PixelPlane pixels;
+    Plane<uchar> gray;
+    // 竖直 seam 的能量；卷积核转置后能量改变时水平 seam 另用 horizontal_energy
+    Plane<int> energy;
+    Plane<int> horizontal_energy;
+    bool shared = true;
+    Candidate candidates[2];
+    long long removed = 0;
+    int seams[2] = {0, 0};
+    bool last = false;
+
+    bool forward() const;
+    const Plane<int> &energy_for(bool horizontal) const;
+    void find_candidate(bool horizontal);
+    void remove(bool horizontal);
+};
+
+// 把 image 缩小到 width x height（不大于原尺寸），removed 不为空时写入被移除的能量
+QImage retarget_2d(
+    const QImage &image, int width, int height,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    long long *removed = nullptr
+);
+
+#endif // RETARGET_2D_H
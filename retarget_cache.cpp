@@ -0,0 +1,114 @@
+#include "retarget_cache.h"
+
+// 会话中每个像素除像素本身外占用的字节：灰度、能量、原坐标与移除顺序
+static const qint64 session_bytes_per_pixel = sizeof(uchar) + sizeof(int) + sizeof(int) + sizeof(quint32);
+
+RetargetCache::RetargetCache(qint64 capacity) : capacity(capacity) {
+    counters.capacity = capacity;
+}
+
+QImage RetargetCache::retarget(
+    const QByteArray &key, const QImage &image, const QString &op,
+    bool horizontal, int size, Result *result
+) {
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    if (op != "Forward" && !find_kernels(op, kernelX, kernelY, window)) {
+        return QImage();
+    }
+    const int original = horizontal ? image.height() : image.width();
+    if (size >= original) {
+        return image;
+    }
+    size = qMax(1, size);
+
+    const std::string name = key.toStdString() + '/' + op.toStdString() + (horizontal ? "/h" : "/v");
+    std::shared_ptr<Entry> entry;
+    bool created = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(name);
+        if (found != entries.end()) {
+            entry = found->second;
+            lru.splice(lru.begin(), lru, entry->position);
+        } else {
+            entry = std::make_shared<Entry>();
+            lru.push_front(name);
+            entry->position = lru.begin();
+            entries.emplace(name, entry);
+            created = true;
+        }
+    }
+
+    std::unique_lock<std::mutex> entry_lock(entry->mutex);
+    if (entry->image.isNull()) {
+        entry->image = image;
+        entry->session.reset(new CarveSession(image, kernelX, kernelY, window, horizontal));
+        entry->session->record_removal_order();
+    }
+    // 缓存中的移除顺序只有前 seams 条 seam 有效
+    const int needed = original - size;
+    Result outcome = Hit;
+    if (entry->map.isNull() || entry->map.seams < needed) {
+        outcome = created ? Miss : Partial;
+        CarveSession &session = *entry->session;
+        while (session.seams_removed() < needed) {
+            session.carve();
+        }
+        entry->map = seam_map_from_order(session.removal_order(), session.seams_removed(), horizontal);
+        if (session.seams_removed() >= original - 1) {
+            entry->session.reset();
+        }
+    }
+    QImage output = retarget_with_seam_map(entry->image, entry->map, size);
+
+    // 会话按原图的像素格式保存像素，与原图一样按 sizeInBytes 计
+    const qint64 area = (qint64) image.width() * image.height();
+    const qint64 pixels = entry->image.sizeInBytes();
+    const qint64 bytes = pixels + area * sizeof(quint32) +
+                         (entry->session ? pixels + area * session_bytes_per_pixel : 0);
+    entry_lock.unlock();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.hits += outcome == Hit;
+    counters.partial += outcome == Partial;
+    counters.misses += outcome == Miss;
+    // 条目可能在处理期间已被淘汰，此时不再计入
+    auto found = entries.find(name);
+    if (found != entries.end() && found->second == entry) {
+        counters.bytes += bytes - entry->bytes;
+        entry->bytes = bytes;
+        evict(name);
+    }
+    if (result != nullptr) {
+        *result = outcome;
+    }
+    return output;
+}
+
+// 从最久未使用的条目开始淘汰，至少保留刚使用的 keep
+void RetargetCache::evict(const std::string &keep) {
+    while (counters.bytes > capacity && lru.size() > 1) {
+        const std::string &name = lru.back() == keep ? *std::prev(lru.end(), 2) : lru.back();
+        auto found = entries.find(name);
+        counters.bytes -= found->second->bytes;
+        counters.evictions++;
+        lru.erase(found->second->position);
+        entries.erase(found);
+    }
+}
+
+RetargetCache::Stats RetargetCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = counters;
+    result.entries = entries.size();
+    return result;
+}
+
+void RetargetCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    lru.clear();
+    entries.clear();
+    counters.bytes = 0;
+}
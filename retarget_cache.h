@@ -0,0 +1,80 @@
+#ifndef RETARGET_CACHE_H
+#define RETARGET_CACHE_H
+
+#include "seam_carver.h"
+#include "carve_session.h"
+#include "seam_map.h"
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 常驻进程中按图像内容缓存的单方向 seam 移除顺序
+// 每个条目以（内容哈希, 算子, 方向）为键，保存解码后的原图和一个可以继续移除的 CarveSession，
+// 后者带有灰度图、未正则化的能量以及已经记录的移除顺序。
+// 同一张图之前已缩小到不大于 size 时直接按移除顺序过滤像素；否则只继续移除还差的 seam。
+// 条目按最近使用的顺序淘汰，估算的总内存不超过 capacity 字节；可以在多个线程中同时调用，
+// 不同条目并行处理，同一条目上的请求串行
+class RetargetCache
+{
+public:
+    enum Result {
+        // 已有足够的 seam
+        Hit,
+        // 条目存在，但需要继续移除 seam
+        Partial,
+        Miss
+    };
+
+    struct Stats {
+        long long hits = 0;
+        long long partial = 0;
+        long long misses = 0;
+        long long evictions = 0;
+        qint64 bytes = 0;
+        qint64 capacity = 0;
+        int entries = 0;
+    };
+
+    explicit RetargetCache(qint64 capacity);
+
+    // 把 image 缩小到 size（horizontal 为 false 时是宽度，否则是高度），size 大于原尺寸时返回原图
+    // key 为调用者计算的内容哈希，同一 key 必须对应同一张图；op 为 find_kernels 可识别的名称或 Forward
+    // 算子未知时返回空图像
+    QImage retarget(
+        const QByteArray &key, const QImage &image, const QString &op,
+        bool horizontal, int size, Result *result = nullptr
+    );
+
+    Stats stats() const;
+    void clear();
+
+private:
+    struct Entry {
+        // 同一条目上的请求串行
+        std::mutex mutex;
+        QImage image;
+        // 缩到最小（只剩一列或一行）之后释放
+        std::unique_ptr<CarveSession> session;
+        SeamMap map;
+        qint64 bytes = 0;
+        std::list<std::string>::iterator position;
+    };
+
+    qint64 capacity;
+    mutable std::mutex mutex;
+    // 最近使用的键在前
+    std::list<std::string> lru;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+    Stats counters;
+
+    void evict(const std::string &keep);
+};
+
+#endif // RETARGET_CACHE_H
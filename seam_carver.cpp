@@ -1,201 +1,798 @@
 #include "seam_carver.h"
+#include "pixel_plane.h"
+#include "energy_kernels.h"
+#include "window_energy.h"
+#include "worker_pool.h"
+#include "trace.h"
 
 #include <QImage>
 #include <QTransform>
 
+#include <algorithm>
 #include <array>
+#include <climits>
+#include <cstring>
+#include <functional>
+#include <limits>
 
 typedef int Kernel[3][3];
 
+// 能量按水平条带并行计算时每个线程至少处理的像素数
+static const int energy_grain_pixels = 64 * 1024;
+// 动态规划并行时每个线程在每条 DP 线上至少处理的像素数
+static const int dp_grain = 2048;
+
+static int energy_grain_rows(int col) {
+    return qMax(1, energy_grain_pixels / qMax(1, col));
+}
+
+bool find_kernels(const QString &name, const Kernel *&kernelX, const Kernel *&kernelY, WindowEnergy &window) {
+    window = WindowEnergy::None;
+    if (name == "Sobel") {
+        kernelX = &SobelX;
+        kernelY = &SobelY;
+    } else if (name == "Prewitt") {
+        kernelX = &PrewittX;
+        kernelY = &PrewittY;
+    } else if (name == "Scharr") {
+        kernelX = &ScharrX;
+        kernelY = &ScharrY;
+    } else if (name == "Roberts") {
+        kernelX = &RobertsX;
+        kernelY = &RobertsY;
+    } else if (name == "HoG") {
+        kernelX = &SobelX;
+        kernelY = &SobelY;
+        window = WindowEnergy::HoG;
+    } else if (name == "Entropy") {
+        kernelX = &SobelX;
+        kernelY = &SobelY;
+        window = WindowEnergy::Entropy;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 void rgb2gray(const QImage &image, QImage &output) {
-    output = image;
-    for (int i = 0; i < image.width(); i++) {
-        for (int j = 0; j < image.height(); j++) {
-            QRgb pixel = image.pixel(i, j);
-            int gray = qGray(pixel);
-            output.setPixel(i, j, qRgb(gray, gray, gray));
-        }
+    SEAM_CARVER_TRACE_PIXELS("rgb2gray", (long long) image.width() * image.height());
+    Plane<uchar> gray;
+    PixelPlane(image).gray(gray);
+    output = QImage(gray.width(), gray.height(), QImage::Format_Grayscale8);
+    for (int y = 0; y < gray.height(); y++) {
+        std::memcpy(output.scanLine(y), gray.row(y), gray.width());
     }
 }
 
+void rgb2gray(const Plane<QRgb> &image, Plane<uchar> &output) {
+    SEAM_CARVER_TRACE_PIXELS("rgb2gray", (long long) image.width() * image.height());
+    output.resize(image.width(), image.height());
+    WorkerPool::global().parallel_for(0, image.height(), energy_grain_rows(image.width()), [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const QRgb *line = image.row(y);
+            uchar *g = output.row(y);
+            for (int x = 0; x < image.width(); x++) {
+                g[x] = qGray(line[x]);
+            }
+        }
+    });
+}
+
 void calc_energy_conv(
     const QImage& image, QImage& output,
+    const Kernel& kernelX, const Kernel& kernelY,
+    WindowEnergy window
+) {
+    SEAM_CARVER_TRACE_PIXELS("calc_energy_conv", (long long) image.width() * image.height());
+    Plane<uchar> gray;
+    Plane<int> energy;
+    PixelPlane(image).gray(gray);
+    calc_energy_conv(gray, energy, kernelX, kernelY, window);
+
+    // 正则化
+    normalize(energy, output);
+}
+
+void calc_energy_conv(
+    const Plane<uchar> &gray, Plane<int> &output,
+    const Kernel& kernelX, const Kernel& kernelY,
+    WindowEnergy window
+) {
+    SEAM_CARVER_TRACE_PIXELS("calc_energy_conv", (long long) gray.width() * gray.height());
+    if (window != WindowEnergy::None) {
+        calc_energy_window(gray, output, window);
+        return;
+    }
+    const ConvEnergyKernels *kernels = find_conv_energy_kernels(kernelX, kernelY);
+    if (kernels == nullptr) {
+        calc_energy_conv_reference(gray, output, kernelX, kernelY);
+        return;
+    }
+    output.resize(gray.width(), gray.height());
+    WorkerPool::global().parallel_for(0, gray.height(), energy_grain_rows(gray.width()), [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            conv_energy_row(*kernels, gray, output, y);
+        }
+    });
+}
+
+void calc_energy_conv_span(
+    const Plane<uchar> &gray, Plane<int> &output, int y, int x0, int x1,
+    const Kernel& kernelX, const Kernel& kernelY,
+    WindowEnergy window
+) {
+    if (window != WindowEnergy::None) {
+        std::vector<int> lo(gray.height(), gray.width());
+        std::vector<int> hi(gray.height(), -1);
+        lo[y] = x0;
+        hi[y] = x1;
+        calc_energy_window_lines(gray, output, window, lo, hi);
+        return;
+    }
+    const ConvEnergyKernels *kernels = find_conv_energy_kernels(kernelX, kernelY);
+    if (kernels == nullptr) {
+        calc_energy_conv_reference_span(gray, output, y, x0, x1, kernelX, kernelY);
+        return;
+    }
+    kernels->span(gray, output, y, x0, x1);
+}
+
+void calc_energy_conv_reference(
+    const Plane<uchar> &gray, Plane<int> &output,
     const Kernel& kernelX, const Kernel& kernelY
 ) {
-    output = image;
-    Mat2d energy(image.width(), std::vector<int>(image.height(), 0));
-
-    int max_grad = 0;
-    int min_grad = std::numeric_limits<int>::max();
-
-    const int col = image.width();
-    const int row = image.height();
-    for (int x = 0; x < col; x++) {
-        for (int y = 0; y < row; y++) {
-            int gx = 0;
-            int gy = 0;
-            for (int k = 0; k < 3; ++k) {
-                for (int l = 0; l < 3; ++l) {
-                    int _x = qBound(0, x + k - 1, col - 1);
-                    int _y = qBound(0, y + l - 1, row - 1);
-                    int pixel = qGray(image.pixel(_x, _y));
-                    gx += pixel * kernelX[k][l];
-                    gy += pixel * kernelY[k][l];
-                }
+    output.resize(gray.width(), gray.height());
+    WorkerPool::global().parallel_for(0, gray.height(), energy_grain_rows(gray.width()), [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            calc_energy_conv_reference_span(gray, output, y, 0, gray.width() - 1, kernelX, kernelY);
+        }
+    });
+}
+
+void calc_energy_conv_reference_span(
+    const Plane<uchar> &gray, Plane<int> &output, int y, int x0, int x1,
+    const Kernel& kernelX, const Kernel& kernelY
+) {
+    const int col = gray.width();
+    const int row = gray.height();
+    // 越界的行和列取边界上的值
+    const uchar *lines[3] = {
+        gray.row(qMax(0, y - 1)), gray.row(y), gray.row(qMin(row - 1, y + 1))
+    };
+    int *energy = output.row(y);
+    for (int x = x0; x <= x1; x++) {
+        const int xs[3] = {qMax(0, x - 1), x, qMin(col - 1, x + 1)};
+        int gx = 0;
+        int gy = 0;
+        for (int k = 0; k < 3; ++k) {
+            for (int l = 0; l < 3; ++l) {
+                int pixel = lines[l][xs[k]];
+                gx += pixel * kernelX[k][l];
+                gy += pixel * kernelY[k][l];
             }
-            energy[x][y] = (qAbs(gx) + qAbs(gy)) / 2;
-            max_grad = qMax(max_grad, energy[x][y]);
-            min_grad = qMin(min_grad, energy[x][y]);
         }
+        energy[x] = (qAbs(gx) + qAbs(gy)) / 2;
     }
-
-    // 正则化
-    normalize(output, energy, max_grad, min_grad);
 }
 
 void calc_energy_forward(
-    QImage &image, QImage &output
+    QImage &image, QImage &output, bool horizontal
 ) {
-    const int row = image.height();
-    const int col = image.width();
-    int max_energy = 0;
-    int min_energy = std::numeric_limits<int>::max();
-    output = QImage(col, row, image.format());
+    SEAM_CARVER_TRACE_PIXELS("calc_energy_forward", (long long) image.width() * image.height());
+    Plane<uchar> gray;
+    Plane<int> energy;
+    PixelPlane(image).gray(gray);
+    calc_energy_forward(gray, energy, horizontal);
 
-    Mat2d energy(col, std::vector<int>(row, 0));
+    // 正则化
+    normalize(energy, output);
+}
 
-    for (int y = 0; y < row; y++) {
-        for (int x = 0; x < col; x++) {
-            int top = qBound(0, y - 1, row - 1);
-            int below = qBound(0, y + 1, row - 1);
-            int left = qBound(0, x - 1, col - 1);
-            int right = qBound(0, x + 1, col - 1);
+void calc_energy_forward(const Plane<uchar> &gray, Plane<int> &output, bool horizontal) {
+    SEAM_CARVER_TRACE_PIXELS("calc_energy_forward", (long long) gray.width() * gray.height());
+    output.resize(gray.width(), gray.height());
+    WorkerPool::global().parallel_for(0, gray.height(), energy_grain_rows(gray.width()), [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            calc_energy_forward_span(gray, output, y, 0, gray.width() - 1, horizontal);
+        }
+    });
+}
 
-            int cT = qAbs(qGray(image.pixel(left, y)) - qGray(image.pixel(right, y)));
-            int cL = qAbs(qGray(image.pixel(x, top)) - qGray(image.pixel(left, y))) + cT;
-            int cR = qAbs(qGray(image.pixel(x, top)) - qGray(image.pixel(right, y))) + cT;
+void calc_energy_forward_span(
+    const Plane<uchar> &gray, Plane<int> &output, int y, int x0, int x1, bool horizontal
+) {
+    const int col = gray.width();
+    const int row = gray.height();
+    const uchar *line = gray.row(y);
+    const uchar *top_line = gray.row(qMax(0, y - 1));
+    const uchar *below_line = gray.row(qMin(row - 1, y + 1));
+    int *energy = output.row(y);
+    for (int x = x0; x <= x1; x++) {
+        // 水平 seam 的“左右”是上下两个像素，“上方”是左边的像素
+        int left = horizontal ? top_line[x] : line[qMax(0, x - 1)];
+        int right = horizontal ? below_line[x] : line[qMin(col - 1, x + 1)];
+        int top = horizontal ? line[qMax(0, x - 1)] : top_line[x];
 
-            std::array<int, 3> cTLR = {cT, cL, cR};
-            energy[x][y] = *min_element(cTLR.begin(), cTLR.end());
+        int cT = qAbs(left - right);
+        int cL = qAbs(top - left) + cT;
+        int cR = qAbs(top - right) + cT;
 
-            min_energy = qMin(min_energy, energy[x][y]);
-            max_energy = qMax(max_energy, energy[x][y]);
+        std::array<int, 3> cTLR = {cT, cL, cR};
+        energy[x] = *std::min_element(cTLR.begin(), cTLR.end());
+    }
+}
+
+void transpose_kernel(const Kernel &kernel, Kernel &output) {
+    for (int k = 0; k < 3; k++) {
+        for (int l = 0; l < 3; l++) {
+            output[k][l] = kernel[l][k];
         }
     }
+}
 
-    // 正则化
-    normalize(output, energy, max_energy, min_energy);
+// a == sign * b
+static bool kernel_equal(const Kernel &a, const Kernel &b, int sign) {
+    for (int k = 0; k < 3; k++) {
+        for (int l = 0; l < 3; l++) {
+            if (a[k][l] != sign * b[l][k]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool energy_transpose_invariant(const Kernel &kernelX, const Kernel &kernelY) {
+    // (|gx| + |gy|) / 2 对交换两个卷积核和取反都不变
+    auto same = [](const Kernel &a, const Kernel &b) {
+        return kernel_equal(a, b, 1) || kernel_equal(a, b, -1);
+    };
+    return (same(kernelX, kernelX) && same(kernelY, kernelY)) ||
+           (same(kernelX, kernelY) && same(kernelY, kernelX));
+}
+
+void horizontal_kernels(
+    const Kernel &kernelX, const Kernel &kernelY,
+    Kernel &transposedX, Kernel &transposedY,
+    const Kernel *&outputX, const Kernel *&outputY
+) {
+    if (energy_transpose_invariant(kernelX, kernelY)) {
+        outputX = &kernelX;
+        outputY = &kernelY;
+        return;
+    }
+    transpose_kernel(kernelX, transposedX);
+    transpose_kernel(kernelY, transposedY);
+    outputX = &transposedX;
+    outputY = &transposedY;
+}
+
+// 在未正则化的卷积能量上移除一条 seam，energy 不为空时才正则化写出，仅用于显示
+static void seam_carve_conv(
+    QImage &image, QImage &energy,
+    const Kernel &kernelX, const Kernel &kernelY, bool horizontal
+) {
+    PixelPlane pixels(image);
+    Plane<uchar> gray;
+    Plane<int> raw;
+    pixels.gray(gray);
+    calc_energy_conv(gray, raw, kernelX, kernelY);
+    if (!energy.isNull()) {
+        normalize(raw, energy);
+    }
+
+    pixels.remove_seam(find_seam(raw, horizontal), horizontal);
+    image = pixels.to_image();
 }
 
 void seam_carve(
     QImage& image, QImage &energy,
     const Kernel& kernelX, const Kernel& kernelY
 ) {
-    calc_energy_conv(image, energy, kernelX, kernelY);
-    find_seam_and_carve(image, energy);
+    SEAM_CARVER_TRACE_SCOPE("seam_carve");
+    seam_carve_conv(image, energy, kernelX, kernelY, false);
 }
 
 void seam_carve_horizontally(
     QImage& image, QImage &energy,
     const Kernel& kernelX, const Kernel& kernel
 ) {
-    transpose(image);
-    transpose(energy);
-    seam_carve(image, energy, kernelX, kernel);
-    transpose(image);
-    transpose(energy);
+    SEAM_CARVER_TRACE_SCOPE("seam_carve_horizontally");
+    Kernel transposedX;
+    Kernel transposedY;
+    const Kernel *horizontalX = nullptr;
+    const Kernel *horizontalY = nullptr;
+    horizontal_kernels(kernelX, kernel, transposedX, transposedY, horizontalX, horizontalY);
+    seam_carve_conv(image, energy, *horizontalX, *horizontalY, true);
 }
 
 void seam_carve_forward(QImage& image, QImage &energy) {
-    calc_energy_forward(image, energy);
-    find_seam_and_carve(image, energy);
+    SEAM_CARVER_TRACE_SCOPE("seam_carve_forward");
+    find_seam_and_carve_forward(image, energy);
 }
 
 void seam_carve_forward_horizontally(QImage& image, QImage &energy) {
-    transpose(image);
-    transpose(energy);
-    seam_carve_forward(image, energy);
-    transpose(image);
-    transpose(energy);
+    SEAM_CARVER_TRACE_SCOPE("seam_carve_forward_horizontally");
+    find_seam_and_carve_forward(image, energy, true);
+}
+
+void find_seam_and_carve(QImage& image, QImage &energy, bool horizontal) {
+    SEAM_CARVER_TRACE_PIXELS("find_seam_and_carve", (long long) image.width() * image.height());
+    const QImage energy_rgb = energy.convertToFormat(QImage::Format_RGB32);
+    Plane<int> energy_gray(energy_rgb.width(), energy_rgb.height());
+    for (int y = 0; y < energy_gray.height(); y++) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(energy_rgb.constScanLine(y));
+        int *e = energy_gray.row(y);
+        for (int x = 0; x < energy_gray.width(); x++) {
+            e[x] = qGray(line[x]);
+        }
+    }
+
+    PixelPlane pixels(image);
+    pixels.remove_seam(find_seam(energy_gray, horizontal), horizontal);
+    image = pixels.to_image();
 }
 
-void find_seam_and_carve(QImage& image, QImage &energy) {
-    const int row = energy.height();
-    const int col = energy.width();
-    // dp_sum[i][j] 表示以 (j, i) 结尾的最小路径的总能量
-    Mat2d dp_sum;
-    // dp_from[i][j] 表示以 (j, i) 结尾的最小路径在 i - 1 行的 x 坐标
-    Mat2d dp_from;
-    dp_sum.resize(col);
-    dp_from.resize(col);
-    for (int i = 0; i < col; i++) {
-        dp_sum[i].resize(row);
-        dp_from[i].resize(row);
+void find_seam_and_carve_forward(QImage& image, QImage &energy, bool horizontal) {
+    SEAM_CARVER_TRACE_PIXELS("find_seam_and_carve_forward", (long long) image.width() * image.height());
+    PixelPlane pixels(image);
+    Plane<uchar> gray;
+    pixels.gray(gray);
+    if (!energy.isNull()) {
+        Plane<int> forward;
+        calc_energy_forward(gray, forward, horizontal);
+        normalize(forward, energy);
     }
-    for (int i = 0; i < col; i++) {
-        dp_sum[i][0] = qGray(energy.pixel(i, 0));
-        dp_from[i][0] = i;
+
+    pixels.remove_seam(find_seam_forward(gray, horizontal), horizontal);
+    image = pixels.to_image();
+}
+
+// 计算第 i 条 DP 线上 [j0, j1) 的 dp_sum 与 dp_from，只依赖第 i - 1 条
+// 竖直 seam 的 DP 线是图像的行，水平 seam 的是图像的列；e 为该线上的能量，相邻元素相隔 e_step
+static void dp_line(
+    const int *e, std::ptrdiff_t e_step, int n,
+    Plane<int> &dp_sum, Plane<int> &dp_from,
+    int i, int j0, int j1
+) {
+    const int *prev = dp_sum.row(i - 1);
+    int *sum = dp_sum.row(i);
+    int *from = dp_from.row(i);
+    for (int j = j0; j < j1; ++j) {
+        int sum_left_top = (j == 0) ? INT_MAX : prev[j - 1];
+        int sum_right_top = (j == n - 1) ? INT_MAX : prev[j + 1];
+        int sum_top = prev[j];
+
+        std::array<int, 3> sums = {sum_top, sum_left_top, sum_right_top};
+        int sum_min = *std::min_element(sums.begin(), sums.end());
+
+        from[j] = (sum_min == sum_top) ? j : ((sum_min == sum_left_top) ? j - 1 : j + 1);
+        sum[j] = sum_min + e[j * e_step];
     }
+}
 
-    for (int i = 1; i < row; ++i) {
-        for (int j = 0; j < col; ++j) {
-            int sum_left_top = (j == 0) ? INT_MAX : dp_sum[j - 1][i - 1];
-            int sum_right_top = (j == col - 1) ? INT_MAX : dp_sum[j + 1][i - 1];
-            int sum_top = dp_sum[j][i - 1];
+// 前向能量的递推：移除像素后新相邻的像素之差即为代价，转移代价取决于选择的前驱
+// g 与 g_prev 为第 i 条与第 i - 1 条线上的灰度，相邻元素相隔 g_step
+static void dp_line_forward(
+    const uchar *g, const uchar *g_prev, std::ptrdiff_t g_step, int n,
+    Plane<int> &dp_sum, Plane<int> &dp_from,
+    int i, int j0, int j1
+) {
+    const int *prev = dp_sum.row(i - 1);
+    int *sum = dp_sum.row(i);
+    int *from = dp_from.row(i);
+    for (int j = j0; j < j1; ++j) {
+        const int left = g[qMax(0, j - 1) * g_step];
+        const int right = g[qMin(n - 1, j + 1) * g_step];
+        const int top = g_prev[j * g_step];
+        const int cT = qAbs(left - right);
 
-            std::array<int, 3> sums = {sum_top, sum_left_top, sum_right_top};
-            int sum_min = *min_element(sums.begin(), sums.end());
+        int sum_left_top = (j == 0) ? INT_MAX : prev[j - 1] + cT + qAbs(top - left);
+        int sum_right_top = (j == n - 1) ? INT_MAX : prev[j + 1] + cT + qAbs(top - right);
+        int sum_top = prev[j] + cT;
 
-            dp_from[j][i] = (sum_min == sum_top) ? j : ((sum_min == sum_left_top) ? j - 1 : j + 1);
-            dp_sum[j][i] = sum_min + qGray(energy.pixel(j, i));
+        std::array<int, 3> sums = {sum_top, sum_left_top, sum_right_top};
+        int sum_min = *std::min_element(sums.begin(), sums.end());
+
+        from[j] = (sum_min == sum_top) ? j : ((sum_min == sum_left_top) ? j - 1 : j + 1);
+        sum[j] = sum_min;
+    }
+}
+
+// 每条线只依赖上一条，各线程负责一段，逐条用栅栏同步
+template <typename LineFunction>
+static void dp_lines(int lines, int n, LineFunction line) {
+    SpinBarrier barrier;
+    auto task = [&](int index, int count) {
+        const int j0 = (int) ((long long) n * index / count);
+        const int j1 = (int) ((long long) n * (index + 1) / count);
+        for (int i = 1; i < lines; ++i) {
+            line(i, j0, j1);
+            barrier.wait(count);
         }
+    };
+    // 经 std::ref 传入，std::function 不会为捕获的引用分配内存
+    WorkerPool::global().run(n / dp_grain, std::ref(task));
+}
+
+void seam_dp(const Plane<int> &energy, Plane<int> &dp_sum, Plane<int> &dp_from, bool horizontal) {
+    SEAM_CARVER_TRACE_PIXELS("seam_dp", (long long) energy.width() * energy.height());
+    // lines 条 DP 线，每条长 n
+    const int lines = horizontal ? energy.width() : energy.height();
+    const int n = horizontal ? energy.height() : energy.width();
+    const std::ptrdiff_t line_step = horizontal ? 1 : energy.stride();
+    const std::ptrdiff_t e_step = horizontal ? energy.stride() : 1;
+    dp_sum.reshape(n, lines);
+    dp_from.reshape(n, lines);
+    for (int j = 0; j < n; j++) {
+        dp_sum.at(j, 0) = energy.data()[j * e_step];
+        dp_from.at(j, 0) = j;
+    }
+
+    dp_lines(lines, n, [&](int i, int j0, int j1) {
+        dp_line(energy.data() + i * line_step, e_step, n, dp_sum, dp_from, i, j0, j1);
+    });
+}
+
+void seam_dp_forward(const Plane<uchar> &gray, Plane<int> &dp_sum, Plane<int> &dp_from, bool horizontal) {
+    SEAM_CARVER_TRACE_PIXELS("seam_dp_forward", (long long) gray.width() * gray.height());
+    const int lines = horizontal ? gray.width() : gray.height();
+    const int n = horizontal ? gray.height() : gray.width();
+    const std::ptrdiff_t line_step = horizontal ? 1 : gray.stride();
+    const std::ptrdiff_t g_step = horizontal ? gray.stride() : 1;
+    dp_sum.reshape(n, lines);
+    dp_from.reshape(n, lines);
+    // 第一条线没有前驱，只有左右像素相邻的代价
+    const uchar *g = gray.data();
+    for (int j = 0; j < n; j++) {
+        dp_sum.at(j, 0) = qAbs(g[qMax(0, j - 1) * g_step] - g[qMin(n - 1, j + 1) * g_step]);
+        dp_from.at(j, 0) = j;
     }
 
+    dp_lines(lines, n, [&](int i, int j0, int j1) {
+        dp_line_forward(g + i * line_step, g + (i - 1) * line_step, g_step, n, dp_sum, dp_from, i, j0, j1);
+    });
+}
+
+std::vector<int> trace_seam(const Plane<int> &dp_sum, const Plane<int> &dp_from) {
+    std::vector<int> seam;
+    trace_seam(dp_sum, dp_from, seam);
+    return seam;
+}
+
+void trace_seam(const Plane<int> &dp_sum, const Plane<int> &dp_from, std::vector<int> &seam) {
+    SEAM_CARVER_TRACE_PIXELS("trace_seam", dp_sum.height());
+    const int row = dp_sum.height();
+    const int col = dp_sum.width();
+
     // 找到最小路径的结束点
+    const int *last = dp_sum.row(row - 1);
     int min_energy_col = 0;
-    int min_energy = dp_sum[0][row - 1];
+    int min_energy = last[0];
     for (int i = 1; i < col; ++i) {
-        if (dp_sum[i][row - 1] < min_energy) {
-            min_energy = dp_sum[i][row - 1];
+        if (last[i] < min_energy) {
+            min_energy = last[i];
             min_energy_col = i;
         }
     }
 
     // 构造最小路径
-    // seam[i] 表示 seam 在第 i 行的 x 坐标
-    std::vector<int> seam;
+    // seam[i] 表示 seam 在第 i 条线上的位置
     seam.resize(row);
     seam[row - 1] = min_energy_col;
     for (int i = row - 2; i >= 0; --i)
-        seam[i] = dp_from[seam[i + 1]][i + 1];
+        seam[i] = dp_from.at(seam[i + 1], i + 1);
+}
+
+static std::vector<std::vector<int>> trace_seams(const Plane<int> &dp_sum, const Plane<int> &dp_from, int k) {
+    SEAM_CARVER_TRACE_SCOPE("trace_seams");
+    const int row = dp_sum.height();
+    const int col = dp_sum.width();
+
+    // 按累积能量从小到大尝试每个结束点
+    std::vector<int> ends(col);
+    for (int j = 0; j < col; j++) {
+        ends[j] = j;
+    }
+    const int *last = dp_sum.row(row - 1);
+    std::stable_sort(ends.begin(), ends.end(), [&](int a, int b) { return last[a] < last[b]; });
+
+    // used(j, i) 标记已被前面的 seam 占用的像素
+    Plane<uchar> used(col, row);
+    std::vector<std::vector<int>> seams;
+    std::vector<int> seam(row);
+    for (int end : ends) {
+        if ((int) seams.size() >= k) {
+            break;
+        }
+        if (used.at(end, row - 1)) {
+            continue;
+        }
+        // 沿 dp_from 回溯；遇到已占用的像素时改走相邻未占用且累积能量最小的像素
+        seam[row - 1] = end;
+        bool blocked = false;
+        for (int i = row - 2; i >= 0; --i) {
+            const int x = seam[i + 1];
+            int next = dp_from.at(x, i + 1);
+            if (used.at(next, i)) {
+                next = -1;
+                const int *prev = dp_sum.row(i);
+                for (int candidate = qMax(0, x - 1); candidate <= qMin(col - 1, x + 1); candidate++) {
+                    if (!used.at(candidate, i) && (next < 0 || prev[candidate] < prev[next])) {
+                        next = candidate;
+                    }
+                }
+                if (next < 0) {
+                    blocked = true;
+                    break;
+                }
+            }
+            seam[i] = next;
+        }
+        if (blocked) {
+            continue;
+        }
+        for (int i = 0; i < row; ++i) {
+            used.at(seam[i], i) = 1;
+        }
+        seams.push_back(seam);
+    }
+    return seams;
+}
+
+std::vector<int> find_seam(const Plane<int> &energy, bool horizontal) {
+    // dp_sum(j, i) 表示以第 i 条线上第 j 个像素结尾的最小路径的总能量
+    Plane<int> dp_sum;
+    // dp_from(j, i) 表示该路径在第 i - 1 条线上的位置
+    Plane<int> dp_from;
+    seam_dp(energy, dp_sum, dp_from, horizontal);
+    return trace_seam(dp_sum, dp_from);
+}
+
+void find_seam(const Plane<int> &energy, SeamScratch &scratch, std::vector<int> &seam, bool horizontal) {
+    seam_dp(energy, scratch.dp_sum, scratch.dp_from, horizontal);
+    trace_seam(scratch.dp_sum, scratch.dp_from, seam);
+}
+
+std::vector<std::vector<int>> find_seams(const Plane<int> &energy, int k, bool horizontal) {
+    Plane<int> dp_sum;
+    Plane<int> dp_from;
+    seam_dp(energy, dp_sum, dp_from, horizontal);
+    return trace_seams(dp_sum, dp_from, k);
+}
+
+std::vector<int> find_seam_forward(const Plane<uchar> &gray, bool horizontal) {
+    Plane<int> dp_sum;
+    Plane<int> dp_from;
+    seam_dp_forward(gray, dp_sum, dp_from, horizontal);
+    return trace_seam(dp_sum, dp_from);
+}
+
+void find_seam_forward(const Plane<uchar> &gray, SeamScratch &scratch, std::vector<int> &seam, bool horizontal) {
+    seam_dp_forward(gray, scratch.dp_sum, scratch.dp_from, horizontal);
+    trace_seam(scratch.dp_sum, scratch.dp_from, seam);
+}
+
+std::vector<std::vector<int>> find_seams_forward(const Plane<uchar> &gray, int k, bool horizontal) {
+    Plane<int> dp_sum;
+    Plane<int> dp_from;
+    seam_dp_forward(gray, dp_sum, dp_from, horizontal);
+    return trace_seams(dp_sum, dp_from, k);
+}
+
+// 受限动态规划：第 i 条线只在 [lo[i], hi[i]] 内递推，dp 平面按带内偏移存放
+// cost(i, j, costs) 写入第 i 条线第 j 个像素从上、左上、右上转移的代价，
+// 代价为 Sum 的最大值时该像素不可经过；带内不存在连通的路径时返回空 seam
+template <typename Sum, typename Cost>
+static std::vector<int> banded_seam(int n, const std::vector<int> &lo, const std::vector<int> &hi, Cost cost) {
+    SEAM_CARVER_TRACE_SCOPE("banded_seam");
+    const Sum blocked = std::numeric_limits<Sum>::max();
+    const int lines = lo.size();
+    int band = 1;
+    for (int i = 0; i < lines; i++) {
+        band = qMax(band, hi[i] - lo[i] + 1);
+    }
+    Plane<Sum> dp_sum(band, lines);
+    Plane<int> dp_from(band, lines);
+    std::array<Sum, 3> costs;
+    for (int j = lo[0]; j <= hi[0]; j++) {
+        cost(0, j, costs);
+        dp_sum.at(j - lo[0], 0) = costs[0];
+    }
+    for (int i = 1; i < lines; i++) {
+        const Sum *prev = dp_sum.row(i - 1);
+        Sum *sum = dp_sum.row(i);
+        int *from = dp_from.row(i);
+        const int prev_lo = lo[i - 1];
+        const int prev_hi = hi[i - 1];
+        // 带外的前驱不可达
+        auto prev_sum = [&](int j) { return (j < prev_lo || j > prev_hi) ? blocked : prev[j - prev_lo]; };
+        for (int j = lo[i]; j <= hi[i]; j++) {
+            cost(i, j, costs);
+            from[j - lo[i]] = j;
+            if (costs[0] == blocked) {
+                sum[j - lo[i]] = blocked;
+                continue;
+            }
+            Sum sum_top = prev_sum(j);
+            Sum sum_left_top = (j == 0) ? blocked : prev_sum(j - 1);
+            Sum sum_right_top = (j == n - 1) ? blocked : prev_sum(j + 1);
+            sum_top = sum_top == blocked ? blocked : sum_top + costs[0];
+            sum_left_top = sum_left_top == blocked ? blocked : sum_left_top + costs[1];
+            sum_right_top = sum_right_top == blocked ? blocked : sum_right_top + costs[2];
+
+            std::array<Sum, 3> sums = {sum_top, sum_left_top, sum_right_top};
+            Sum sum_min = *std::min_element(sums.begin(), sums.end());
+
+            from[j - lo[i]] = (sum_min == sum_top) ? j : ((sum_min == sum_left_top) ? j - 1 : j + 1);
+            sum[j - lo[i]] = sum_min;
+        }
+    }
 
-    // 剪切最小路径
-    QImage new_image = QImage(col - 1, row, image.format());
-    for (int i = 0; i < row; ++i) {
-        for (int j = 0; j < seam[i]; j++) {
-            new_image.setPixel(j, i, image.pixel(j, i));
+    const int last = lines - 1;
+    int end = lo[last];
+    for (int j = lo[last] + 1; j <= hi[last]; j++) {
+        if (dp_sum.at(j - lo[last], last) < dp_sum.at(end - lo[last], last)) {
+            end = j;
         }
-        for (int j = seam[i]; j < col - 1; j++) {
-            new_image.setPixel(j, i, image.pixel(j + 1, i));
+    }
+    if (dp_sum.at(end - lo[last], last) == blocked) {
+        return std::vector<int>();
+    }
+    std::vector<int> seam(lines);
+    seam[last] = end;
+    for (int i = last - 1; i >= 0; --i) {
+        seam[i] = dp_from.at(seam[i + 1] - lo[i + 1], i + 1);
+    }
+    return seam;
+}
+
+// 前向能量中第 i 条线第 j 个像素的三种转移代价
+static void forward_costs(const Plane<uchar> &gray, int n, int i, int j, bool horizontal, std::array<int, 3> &costs) {
+    auto g = [&](int i, int j) -> int { return horizontal ? gray.at(i, j) : gray.at(j, i); };
+    const int left = g(i, qMax(0, j - 1));
+    const int right = g(i, qMin(n - 1, j + 1));
+    const int cT = qAbs(left - right);
+    if (i == 0) {
+        costs = {cT, cT, cT};
+        return;
+    }
+    const int top = g(i - 1, j);
+    costs = {cT, cT + qAbs(top - left), cT + qAbs(top - right)};
+}
+
+std::vector<int> find_seam_banded(
+    const Plane<int> &energy, const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal
+) {
+    const int n = horizontal ? energy.height() : energy.width();
+    return banded_seam<int>(n, lo, hi, [&](int i, int j, std::array<int, 3> &costs) {
+        const int e = horizontal ? energy.at(i, j) : energy.at(j, i);
+        costs = {e, e, e};
+    });
+}
+
+std::vector<int> find_seam_forward_banded(
+    const Plane<uchar> &gray, const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal
+) {
+    const int n = horizontal ? gray.height() : gray.width();
+    return banded_seam<int>(n, lo, hi, [&](int i, int j, std::array<int, 3> &costs) {
+        forward_costs(gray, n, i, j, horizontal, costs);
+    });
+}
+
+// 移除区域内每个像素的奖励，须大于任意一条 seam 在掩码外的能量之和，
+// 这样经过更多待移除像素的 seam 总是更优；累积能量用 long long，不会溢出
+static const long long mask_remove_bonus = 1LL << 40;
+
+// 在未加掩码的代价上叠加掩码：保护区域不可经过，移除区域减去 mask_remove_bonus
+static void masked_costs(uchar m, const std::array<int, 3> &raw, std::array<long long, 3> &costs) {
+    if (m == MaskProtect) {
+        costs.fill(std::numeric_limits<long long>::max());
+        return;
+    }
+    const long long bias = m == MaskRemove ? -mask_remove_bonus : 0;
+    for (int t = 0; t < 3; t++) {
+        costs[t] = raw[t] + bias;
+    }
+}
+
+std::vector<int> find_seam_masked(
+    const Plane<int> &energy, const Plane<uchar> &mask,
+    const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal
+) {
+    const int n = horizontal ? energy.height() : energy.width();
+    return banded_seam<long long>(n, lo, hi, [&](int i, int j, std::array<long long, 3> &costs) {
+        const int e = horizontal ? energy.at(i, j) : energy.at(j, i);
+        masked_costs(horizontal ? mask.at(i, j) : mask.at(j, i), {e, e, e}, costs);
+    });
+}
+
+std::vector<int> find_seam_forward_masked(
+    const Plane<uchar> &gray, const Plane<uchar> &mask,
+    const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal
+) {
+    const int n = horizontal ? gray.height() : gray.width();
+    std::array<int, 3> raw;
+    return banded_seam<long long>(n, lo, hi, [&](int i, int j, std::array<long long, 3> &costs) {
+        forward_costs(gray, n, i, j, horizontal, raw);
+        masked_costs(horizontal ? mask.at(i, j) : mask.at(j, i), raw, costs);
+    });
+}
+
+bool mask_from_images(const QImage &protect, const QImage &remove, int width, int height, Plane<uchar> &mask, QString *error) {
+    const QImage *images[2] = {&protect, &remove};
+    for (const QImage *image : images) {
+        if (!image->isNull() && (image->width() != width || image->height() != height)) {
+            if (error != nullptr) {
+                *error = QString("mask is %1x%2, image is %3x%4")
+                    .arg(image->width()).arg(image->height()).arg(width).arg(height);
+            }
+            return false;
         }
     }
-    image = new_image;
+    mask.resize(width, height);
+    // 移除掩码先写入，与保护掩码重叠的像素按保护处理
+    const uchar values[2] = {MaskProtect, MaskRemove};
+    for (int k = 1; k >= 0; k--) {
+        if (images[k]->isNull()) {
+            continue;
+        }
+        const QImage image = images[k]->convertToFormat(QImage::Format_ARGB32);
+        for (int y = 0; y < height; y++) {
+            const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+            uchar *m = mask.row(y);
+            for (int x = 0; x < width; x++) {
+                if (qAlpha(line[x]) >= 128 && qGray(line[x]) >= 128) {
+                    m[x] = values[k];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+long long forward_seam_cost(const Plane<uchar> &gray, const std::vector<int> &seam, bool horizontal) {
+    const int n = horizontal ? gray.height() : gray.width();
+    auto g = [&](int i, int j) -> int { return horizontal ? gray.at(i, j) : gray.at(j, i); };
+    long long cost = 0;
+    for (int i = 0; i < (int) seam.size(); i++) {
+        const int j = seam[i];
+        const int left = g(i, qMax(0, j - 1));
+        const int right = g(i, qMin(n - 1, j + 1));
+        cost += qAbs(left - right);
+        if (i > 0 && seam[i - 1] != j) {
+            cost += qAbs(g(i - 1, j) - (seam[i - 1] < j ? left : right));
+        }
+    }
+    return cost;
 }
 
 void transpose(QImage& image) {
+    SEAM_CARVER_TRACE_PIXELS("transpose", (long long) image.width() * image.height());
     image = image.transformed(QTransform().rotate(90).scale(-1, 1));
 }
 
-void normalize(
-    QImage &image, Mat2d &energy,
-    int max_energy, int min_energy
-) {
+void normalize(const Plane<int> &energy, QImage &output) {
+    SEAM_CARVER_TRACE_PIXELS("normalize", (long long) energy.width() * energy.height());
+    int max_energy = 0;
+    int min_energy = std::numeric_limits<int>::max();
+    for (int y = 0; y < energy.height(); y++) {
+        const int *e = energy.row(y);
+        for (int x = 0; x < energy.width(); x++) {
+            max_energy = qMax(max_energy, e[x]);
+            min_energy = qMin(min_energy, e[x]);
+        }
+    }
+
     int range = max_energy - min_energy;
     if (range == 0) range = 1;
-    for (int y = 0; y < image.height(); y++) {
-        for (int x = 0; x < image.width(); x++) {
-            int g = (energy[x][y] - min_energy) * 255 / range;
-            image.setPixel(x, y, qRgb(g, g, g));
+    output = QImage(energy.width(), energy.height(), QImage::Format_RGB32);
+    for (int y = 0; y < energy.height(); y++) {
+        const int *e = energy.row(y);
+        QRgb *line = reinterpret_cast<QRgb *>(output.scanLine(y));
+        for (int x = 0; x < energy.width(); x++) {
+            int g = (e[x] - min_energy) * 255 / range;
+            line[x] = qRgb(g, g, g);
         }
     }
-}
\ No newline at end of file
+}
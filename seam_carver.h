@@ -1,34 +1,98 @@
 #ifndef SEAM_CARVER_H
 #define SEAM_CARVER_H
 
+#include "image_plane.h"
+#include "window_energy.h"
+#include "trace.h"
+
 #include <QImage>
+#include <QString>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
 
 typedef int Kernel[3][3];
-typedef std::vector<std::vector<int>> Mat2d;
 
-const Kernel SobelX = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
-const Kernel SobelY = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
-const Kernel PrewittX = {{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}};
-const Kernel PrewittY = {{-1, -1, -1}, {0, 0, 0}, {1, 1, 1}};
-const Kernel ScharrX = {{-3, 0, 3}, {-10, 0, 10}, {-3, 0, 3}};
-const Kernel ScharrY = {{-3, -10, -3}, {0, 0, 0}, {3, 10, 3}};
-const Kernel RobertsX = {{0, 0, 0}, {0, 1, 0}, {0, 0, -1}};
-const Kernel RobertsY = {{0, 0, 0}, {0, 0, 1}, {0, -1, 0}};
+inline constexpr Kernel SobelX = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
+inline constexpr Kernel SobelY = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
+inline constexpr Kernel PrewittX = {{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}};
+inline constexpr Kernel PrewittY = {{-1, -1, -1}, {0, 0, 0}, {1, 1, 1}};
+inline constexpr Kernel ScharrX = {{-3, 0, 3}, {-10, 0, 10}, {-3, 0, 3}};
+inline constexpr Kernel ScharrY = {{-3, -10, -3}, {0, 0, 0}, {3, 10, 3}};
+inline constexpr Kernel RobertsX = {{0, 0, 0}, {0, 1, 0}, {0, 0, -1}};
+inline constexpr Kernel RobertsY = {{0, 0, 0}, {0, 0, 1}, {0, -1, 0}};
+// 按名称（Sobel/Prewitt/Scharr/Roberts/HoG/Entropy）查找卷积核与窗口能量，名称未知时返回 false
+// HoG 与 Entropy 的卷积核为 Sobel，window 为对应的窗口能量（见 window_energy.h），其余为 WindowEnergy::None
+bool find_kernels(const QString &name, const Kernel *&kernelX, const Kernel *&kernelY, WindowEnergy &window);
 
+// 输出每像素 1 字节的 Grayscale8 图像，只用于显示；任意格式的像素平面使用 PixelPlane::gray
 void rgb2gray(const QImage &image, QImage &output);
 
+void rgb2gray(const Plane<QRgb> &image, Plane<uchar> &output);
+
+// 正则化到 0~255 的卷积能量图，只用于显示；寻找 seam 使用下面未正则化的版本
 void calc_energy_conv(
     const QImage& image, QImage& output,
-    const Kernel& kernelX, const Kernel& kernelY
+    const Kernel& kernelX, const Kernel& kernelY,
+    WindowEnergy window = WindowEnergy::None
 );
 
+// 在灰度图上计算未正则化的卷积能量
+// 预定义的卷积核使用 energy_kernels.h 中的特化与向量化实现，其余卷积核使用参考实现；
+// window 不为 None 时计算窗口能量，不使用卷积核
 void calc_energy_conv(
-    const QImage& image, QImage& output,
+    const Plane<uchar> &gray, Plane<int> &output,
+    const Kernel& kernelX, const Kernel& kernelY,
+    WindowEnergy window = WindowEnergy::None
+);
+
+// 只重新计算第 y 行 [x0, x1] 范围内的卷积能量
+// 窗口能量逐行调用时每次都要重新统计窗口，连续的范围应使用 update_energy_band 或 calc_energy_window_lines
+void calc_energy_conv_span(
+    const Plane<uchar> &gray, Plane<int> &output, int y, int x0, int x1,
+    const Kernel& kernelX, const Kernel& kernelY,
+    WindowEnergy window = WindowEnergy::None
+);
+
+// 通用 3x3 卷积的标量参考实现，特化版本的结果必须与它逐位一致
+void calc_energy_conv_reference(
+    const Plane<uchar> &gray, Plane<int> &output,
+    const Kernel& kernelX, const Kernel& kernelY
+);
+
+void calc_energy_conv_reference_span(
+    const Plane<uchar> &gray, Plane<int> &output, int y, int x0, int x1,
     const Kernel& kernelX, const Kernel& kernelY
 );
 
-void calc_energy_forward(QImage &image, QImage &output);
+// 每个像素三种转移代价中的最小值，只用于显示能量图；寻找 seam 使用 seam_dp_forward
+// horizontal 为 true 时计算水平 seam 所用的前向能量（结果仍按原图方向存放）
+void calc_energy_forward(QImage &image, QImage &output, bool horizontal = false);
+
+void calc_energy_forward(const Plane<uchar> &gray, Plane<int> &output, bool horizontal = false);
+
+void calc_energy_forward_span(
+    const Plane<uchar> &gray, Plane<int> &output, int y, int x0, int x1,
+    bool horizontal = false
+);
+
+void transpose_kernel(const Kernel &kernel, Kernel &output);
+
+// 卷积能量在图像转置后是否不变（预定义的卷积核都满足）
+bool energy_transpose_invariant(const Kernel &kernelX, const Kernel &kernelY);
 
+// 水平 seam 在原图方向上计算能量时使用的卷积核
+// 能量转置不变时直接返回原卷积核（保留特化实现），否则转置后写入 transposedX/transposedY
+void horizontal_kernels(
+    const Kernel &kernelX, const Kernel &kernelY,
+    Kernel &transposedX, Kernel &transposedY,
+    const Kernel *&outputX, const Kernel *&outputY
+);
+
+// 移除一条 seam，seam 在未正则化的能量上寻找
+// energy 不为空时写入移除前正则化后的能量图，仅用于显示；为空时不做正则化
 void seam_carve(
     QImage& image, QImage &energy,
     const Kernel& kernelX, const Kernel& kernelY
@@ -43,13 +107,163 @@ void seam_carve_forward(QImage& image, QImage &energy);
 
 void seam_carve_forward_horizontally(QImage& image, QImage &energy);
 
-void find_seam_and_carve(QImage& image, QImage &energy);
+// 按已经正则化为灰度图的 energy 移除一条 seam，能量只有 8 位精度，仅为兼容保留
+void find_seam_and_carve(QImage& image, QImage &energy, bool horizontal = false);
 
-void transpose(QImage& image);
+// 使用前向能量移除一条 seam，seam 直接在灰度图上递推得到
+// energy 不为空时写入正则化后的前向能量图，仅用于显示
+void find_seam_and_carve_forward(QImage& image, QImage &energy, bool horizontal = false);
+
+// seam 的动态规划，不转置图像
+// 竖直 seam 逐行递推，水平 seam 逐列递推；dp_sum 与 dp_from 的第 i 行对应第 i 条递推线，
+// dp_sum 为以各像素结尾的最小路径能量，dp_from 为该路径在上一条线上的位置
+void seam_dp(const Plane<int> &energy, Plane<int> &dp_sum, Plane<int> &dp_from, bool horizontal = false);
+
+// 前向能量的动态规划（Rubinstein 等）
+// 代价不是逐像素的能量，而是移除 seam 后新相邻像素之差，取决于 seam 从哪个前驱转移而来，
+// 因此在递推中直接由灰度图计算 cL、cT、cR，不生成能量图
+void seam_dp_forward(const Plane<uchar> &gray, Plane<int> &dp_sum, Plane<int> &dp_from, bool horizontal = false);
 
-void normalize(
-    QImage &image, std::vector<std::vector<int>> &energy,
-    int max_energy, int min_energy
+// 从最后一条线上累积能量最小的位置沿 dp_from 回溯出 seam
+std::vector<int> trace_seam(const Plane<int> &dp_sum, const Plane<int> &dp_from);
+// 同上，写入调用者的 seam，容量足够时不分配
+void trace_seam(const Plane<int> &dp_sum, const Plane<int> &dp_from, std::vector<int> &seam);
+
+// 逐条寻找 seam 时复用的动态规划缓冲区
+// 图像只会变小，第一次之后 dp_sum 与 dp_from 都不再重新分配
+struct SeamScratch {
+    Plane<int> dp_sum;
+    Plane<int> dp_from;
+};
+
+// 在能量图上寻找能量最小的 seam
+// 竖直 seam 中 seam[y] 为第 y 行被移除像素的 x 坐标，水平 seam 中 seam[x] 为第 x 列被移除像素的 y 坐标
+std::vector<int> find_seam(const Plane<int> &energy, bool horizontal = false);
+// 同上，使用 scratch 中的缓冲区并写入 seam，稳定状态下不分配内存
+void find_seam(const Plane<int> &energy, SeamScratch &scratch, std::vector<int> &seam, bool horizontal = false);
+
+// 从同一张累积能量图中取出至多 k 条互不相交的低能量 seam（近似），按累积能量从小到大排列
+std::vector<std::vector<int>> find_seams(const Plane<int> &energy, int k, bool horizontal = false);
+
+// 与 find_seam / find_seams 相同，但使用前向能量
+std::vector<int> find_seam_forward(const Plane<uchar> &gray, bool horizontal = false);
+void find_seam_forward(const Plane<uchar> &gray, SeamScratch &scratch, std::vector<int> &seam, bool horizontal = false);
+std::vector<std::vector<int>> find_seams_forward(const Plane<uchar> &gray, int k, bool horizontal = false);
+
+// 只在第 i 条线的 [lo[i], hi[i]] 范围内寻找 seam，用于在投影路径附近细化
+// 相邻两条线的范围须相交或相邻，保证带内存在连通的路径
+std::vector<int> find_seam_banded(
+    const Plane<int> &energy, const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal = false
+);
+std::vector<int> find_seam_forward_banded(
+    const Plane<uchar> &gray, const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal = false
 );
 
+// 保护/移除掩码中每个像素的取值
+enum SeamMask : uchar {
+    MaskNone = 0,
+    // 任何 seam 都不经过
+    MaskProtect = 1,
+    // seam 优先经过，经过的移除像素越多越好
+    MaskRemove = 2
+};
+
+// 带掩码的受限动态规划，参数与 find_seam_banded 相同，mask 与能量图同尺寸
+// 保护区域的代价为无穷大，带内不存在避开保护区域的路径时返回空 seam
+std::vector<int> find_seam_masked(
+    const Plane<int> &energy, const Plane<uchar> &mask,
+    const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal = false
+);
+std::vector<int> find_seam_forward_masked(
+    const Plane<uchar> &gray, const Plane<uchar> &mask,
+    const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal = false
+);
+
+// 由保护与移除掩码图生成掩码，不透明且亮度不低于 128 的像素被标记，两者重叠时按保护处理
+// 掩码图可以为空；尺寸与 width x height 不同时返回 false，原因写入 error
+bool mask_from_images(
+    const QImage &protect, const QImage &remove, int width, int height,
+    Plane<uchar> &mask, QString *error = nullptr
+);
+
+// 前向能量下移除 seam 新产生的代价之和
+long long forward_seam_cost(const Plane<uchar> &gray, const std::vector<int> &seam, bool horizontal = false);
+
+// 以下移除函数都原地进行：像素在行内或列内前移，只缩小逻辑尺寸，stride 与缓冲区不变，不分配内存
+
+// 按 seam 删除每一行中的一个元素，宽度减一；每行只把 seam 右侧的部分左移一位
+template <typename T>
+void remove_seam(Plane<T> &plane, const std::vector<int> &seam) {
+    static_assert(std::is_trivially_copyable<T>::value, "remove_seam moves elements with memmove");
+    SEAM_CARVER_TRACE_PIXELS("remove_seam", (long long) plane.width() * plane.height());
+    const int col = plane.width();
+    for (int y = 0; y < plane.height(); y++) {
+        T *line = plane.row(y);
+        std::memmove(line + seam[y], line + seam[y] + 1, (col - seam[y] - 1) * sizeof(T));
+    }
+    plane.truncate(col - 1, plane.height());
+}
+
+// 同时删除每行中的 k 个元素，positions 中第 y 行的 k 个 x 坐标为 positions[y * k ... y * k + k - 1]，已升序排列
+template <typename T>
+void remove_seams(Plane<T> &plane, const std::vector<int> &positions, int k) {
+    static_assert(std::is_trivially_copyable<T>::value, "remove_seams moves elements with memmove");
+    SEAM_CARVER_TRACE_PIXELS("remove_seams", (long long) plane.width() * plane.height());
+    const int col = plane.width();
+    for (int y = 0; y < plane.height(); y++) {
+        T *line = plane.row(y);
+        const int *p = positions.data() + (std::size_t) y * k;
+        // 第 j 个与第 j + 1 个被删除元素之间的一段左移 j + 1 位
+        for (int j = 0; j < k; j++) {
+            const int next = j + 1 < k ? p[j + 1] : col;
+            std::memmove(line + p[j] - j, line + p[j] + 1, (next - p[j] - 1) * sizeof(T));
+        }
+    }
+    plane.truncate(col - k, plane.height());
+}
+
+// 按水平 seam 删除每一列中的一个元素，seam 以下的部分上移，高度减一
+template <typename T>
+void remove_horizontal_seam(Plane<T> &plane, const std::vector<int> &seam) {
+    SEAM_CARVER_TRACE_PIXELS("remove_horizontal_seam", (long long) plane.width() * plane.height());
+    const int col = plane.width();
+    // seam 最高点以上的行不变
+    const int top = *std::min_element(seam.begin(), seam.end());
+    for (int y = top; y < plane.height() - 1; y++) {
+        T *line = plane.row(y);
+        const T *below = plane.row(y + 1);
+        for (int x = 0; x < col; x++) {
+            line[x] = y < seam[x] ? line[x] : below[x];
+        }
+    }
+    plane.truncate(col, plane.height() - 1);
+}
+
+// 同时删除每列中的 k 个元素，positions 中第 x 列的 k 个 y 坐标为 positions[x * k ... x * k + k - 1]，已升序排列
+// 第 y 行只读取不早于第 y 行的元素，因此可以自上而下原地写入
+template <typename T>
+void remove_horizontal_seams(Plane<T> &plane, const std::vector<int> &positions, int k) {
+    SEAM_CARVER_TRACE_PIXELS("remove_horizontal_seams", (long long) plane.width() * plane.height());
+    const int col = plane.width();
+    const int row = plane.height() - k;
+    // shift[x] 为第 x 列当前输出行之前已删除的元素个数
+    std::vector<int> shift(col, 0);
+    for (int y = 0; y < row; y++) {
+        T *line = plane.row(y);
+        for (int x = 0; x < col; x++) {
+            const int *p = positions.data() + (std::size_t) x * k;
+            while (shift[x] < k && p[shift[x]] <= y + shift[x]) {
+                shift[x]++;
+            }
+            line[x] = plane.at(x, y + shift[x]);
+        }
+    }
+    plane.truncate(col, row);
+}
+
+void transpose(QImage& image);
+
+// 将能量线性映射到 0~255 并写成灰度 QImage
+void normalize(const Plane<int> &energy, QImage &output);
+
 #endif // SEAM_CARVER_H
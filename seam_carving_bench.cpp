@@ -0,0 +1,255 @@
+#include "seam_carver.h"
+#include "carve_session.h"
+#include "energy_kernels.h"
+#include "worker_pool.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QStringList>
+
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// 一个阶段的测量结果，seconds 为多次运行中最快的一次
+struct BenchResult {
+    QString image;
+    int width;
+    int height;
+    QString op;
+    QString direction;
+    QString stage;
+    int runs;
+    double seconds;
+    // 每次运行处理的 seam 条数，只有 session 阶段大于 1
+    int seams;
+};
+
+struct BenchOptions {
+    int repeat = 3;
+    int seams = 8;
+};
+
+static const QStringList operators = {"Sobel", "Prewitt", "Scharr", "Roberts", "HoG", "Entropy", "Forward"};
+
+// 运行 repeat 次，返回最快一次的秒数；setup 不计入时间
+static double measure(int repeat, const std::function<void()> &setup, const std::function<void()> &body) {
+    double best = std::numeric_limits<double>::max();
+    QElapsedTimer timer;
+    for (int i = 0; i < repeat; i++) {
+        if (setup) {
+            setup();
+        }
+        timer.start();
+        body();
+        best = qMin(best, timer.nsecsElapsed() / 1e9);
+    }
+    return best;
+}
+
+// 确定性的合成图像：渐变叠加伪随机噪声
+static QImage synthetic_image(int width, int height) {
+    QImage image(width, height, QImage::Format_RGB32);
+    quint32 state = 12345;
+    for (int y = 0; y < height; y++) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; x++) {
+            state = state * 1664525u + 1013904223u;
+            const int noise = (state >> 24) & 31;
+            line[x] = qRgb((x * 255 / width + noise) & 255, (y * 255 / height + noise) & 255, ((x ^ y) + noise) & 255);
+        }
+    }
+    return image;
+}
+
+static void bench_image(
+    const QString &name, const QImage &image,
+    const BenchOptions &options, std::vector<BenchResult> &results
+) {
+    const int repeat = options.repeat;
+    auto add = [&](const QString &op, const QString &direction, const QString &stage, double seconds, int seams) {
+        results.push_back({name, image.width(), image.height(), op, direction, stage, repeat, seconds, seams});
+        std::fprintf(stderr, "%s %s %s %s: %.3f ms\n", qPrintable(name), qPrintable(op),
+                     qPrintable(direction), qPrintable(stage), seconds * 1e3);
+    };
+
+    Plane<QRgb> pixels;
+    image_to_plane(image, pixels);
+    Plane<uchar> gray;
+    add("", "", "rgb2gray", measure(repeat, {}, [&]() { rgb2gray(pixels, gray); }), 1);
+    Plane<QRgb> transposed;
+    add("", "", "transpose", measure(repeat, {}, [&]() { transpose(pixels, transposed); }), 1);
+
+    for (const QString &op : operators) {
+        for (int h = 0; h < 2; h++) {
+            const bool horizontal = h == 1;
+            const QString direction = horizontal ? "horizontal" : "vertical";
+            const Kernel *sessionX = nullptr;
+            const Kernel *sessionY = nullptr;
+            WindowEnergy window = WindowEnergy::None;
+            const bool forward = !find_kernels(op, sessionX, sessionY, window);
+            // 水平方向的能量使用转置后的卷积核，CarveSession 内部自行处理
+            const Kernel *kernelX = sessionX;
+            const Kernel *kernelY = sessionY;
+            Kernel transposedX;
+            Kernel transposedY;
+            if (!forward && horizontal && window == WindowEnergy::None) {
+                horizontal_kernels(*sessionX, *sessionY, transposedX, transposedY, kernelX, kernelY);
+            }
+
+            // 前向能量在 DP 中计算，energy 阶段测的是仅用于显示的能量图
+            Plane<int> energy;
+            add(op, direction, "energy", measure(repeat, {}, [&]() {
+                if (forward) {
+                    calc_energy_forward(gray, energy, horizontal);
+                } else {
+                    calc_energy_conv(gray, energy, *kernelX, *kernelY, window);
+                }
+            }), 1);
+
+            Plane<int> dp_sum;
+            Plane<int> dp_from;
+            add(op, direction, "dp", measure(repeat, {}, [&]() {
+                if (forward) {
+                    seam_dp_forward(gray, dp_sum, dp_from, horizontal);
+                } else {
+                    seam_dp(energy, dp_sum, dp_from, horizontal);
+                }
+            }), 1);
+
+            std::vector<int> seam;
+            add(op, direction, "backtrack", measure(repeat, {}, [&]() { seam = trace_seam(dp_sum, dp_from); }), 1);
+
+            Plane<QRgb> carved;
+            add(op, direction, "carve", measure(repeat, [&]() { carved = pixels; }, [&]() {
+                if (horizontal) {
+                    remove_horizontal_seam(carved, seam);
+                } else {
+                    remove_seam(carved, seam);
+                }
+            }), 1);
+
+            // 端到端：建立会话后逐条移除 seam（含窄带能量更新）
+            const int seams = qMin(options.seams, (horizontal ? image.height() : image.width()) - 1);
+            if (seams <= 0) {
+                continue;
+            }
+            std::unique_ptr<CarveSession> session;
+            add(op, direction, "session", measure(repeat, [&]() {
+                session.reset(new CarveSession(image, sessionX, sessionY, window, horizontal));
+            }, [&]() {
+                for (int i = 0; i < seams; i++) {
+                    session->carve();
+                }
+            }), seams);
+        }
+    }
+}
+
+static const char *simd_name() {
+    switch (simd_level()) {
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+static void write_csv(FILE *out, const std::vector<BenchResult> &results) {
+    std::fprintf(out, "image,width,height,operator,direction,stage,runs,seconds,ns_per_pixel,seams_per_sec\n");
+    for (const BenchResult &r : results) {
+        const double pixels = (double) r.width * r.height * r.seams;
+        std::fprintf(out, "%s,%d,%d,%s,%s,%s,%d,%.9f,%.4f,%.3f\n",
+                     qPrintable(r.image), r.width, r.height, qPrintable(r.op), qPrintable(r.direction),
+                     qPrintable(r.stage), r.runs, r.seconds, r.seconds * 1e9 / pixels, r.seams / r.seconds);
+    }
+}
+
+static void write_json(FILE *out, const std::vector<BenchResult> &results) {
+    std::fprintf(out, "{\n  \"threads\": %d,\n  \"simd\": \"%s\",\n  \"results\": [\n",
+                 WorkerPool::global().size(), simd_name());
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        const double pixels = (double) r.width * r.height * r.seams;
+        std::fprintf(out, "    {\"image\": \"%s\", \"width\": %d, \"height\": %d, \"operator\": \"%s\", "
+                          "\"direction\": \"%s\", \"stage\": \"%s\", \"runs\": %d, \"seconds\": %.9f, "
+                          "\"ns_per_pixel\": %.4f, \"seams_per_sec\": %.3f}%s\n",
+                     qPrintable(r.image), r.width, r.height, qPrintable(r.op), qPrintable(r.direction),
+                     qPrintable(r.stage), r.runs, r.seconds, r.seconds * 1e9 / pixels, r.seams / r.seconds,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("seam-carving-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Per-stage seam carving benchmark.");
+    parser.addHelpOption();
+    QCommandLineOption images_option({"i", "images"}, "Directory with the benchmark images.", "dir", "test_images");
+    QCommandLineOption synthetic_option({"s", "synthetic"}, "Synthetic sizes to add: comma-separated list of 4k, 8k or none.", "sizes", "4k,8k");
+    QCommandLineOption repeat_option({"r", "repeat"}, "Runs per stage; the fastest run is reported.", "n", "3");
+    QCommandLineOption seams_option("seams", "Seams removed per run in the end-to-end session stage.", "n", "8");
+    QCommandLineOption format_option({"f", "format"}, "Output format: csv or json.", "format", "csv");
+    QCommandLineOption output_option({"o", "output"}, "Write results to <file> instead of stdout.", "file");
+    parser.addOptions({images_option, synthetic_option, repeat_option, seams_option, format_option, output_option});
+    parser.process(app);
+
+    BenchOptions options;
+    options.repeat = qMax(1, parser.value(repeat_option).toInt());
+    options.seams = qMax(0, parser.value(seams_option).toInt());
+    const QString format = parser.value(format_option).toLower();
+    if (format != "csv" && format != "json") {
+        std::fprintf(stderr, "unknown format %s\n", qPrintable(format));
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    QDir dir(parser.value(images_option));
+    for (const QFileInfo &entry : dir.entryInfoList({"*.png", "*.jpg", "*.jpeg", "*.bmp"}, QDir::Files, QDir::Name)) {
+        QImage image(entry.filePath());
+        if (image.isNull()) {
+            std::fprintf(stderr, "cannot read %s\n", qPrintable(entry.filePath()));
+            continue;
+        }
+        bench_image(entry.fileName(), image, options, results);
+    }
+    for (const QString &size : parser.value(synthetic_option).toLower().split(',')) {
+        if (size == "4k") {
+            bench_image("synthetic-4k", synthetic_image(3840, 2160), options, results);
+        } else if (size == "8k") {
+            bench_image("synthetic-8k", synthetic_image(7680, 4320), options, results);
+        } else if (size != "none" && !size.isEmpty()) {
+            std::fprintf(stderr, "unknown synthetic size %s\n", qPrintable(size));
+            return 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if (parser.isSet(output_option)) {
+        out = std::fopen(qPrintable(parser.value(output_option)), "w");
+        if (out == nullptr) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(output_option)));
+            return 1;
+        }
+    }
+    if (format == "json") {
+        write_json(out, results);
+    } else {
+        write_csv(out, results);
+    }
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
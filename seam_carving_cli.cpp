@@ -0,0 +1,519 @@
+#include "seam_carver.h"
+#include "carve_session.h"
+#include "seam_map.h"
+#include "seam_insertion.h"
+#include "retarget_2d.h"
+#include "hybrid_retarget.h"
+#include "stream_carver.h"
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+#include <cstdio>
+
+struct CarveOptions {
+    QString op;
+    QString output_dir;
+    // 目标尺寸，<= 0 表示该方向不变
+    int width = 0;
+    int height = 0;
+    // 按比例缩放时的比例，小于 1 时缩小、大于 1 时放大，<= 0 表示不使用
+    double ratio = 0;
+    bool vertical = true;
+    bool horizontal = false;
+    // 近似模式：每次从一张累积能量图中取出的 seam 数，或占当前尺寸的百分比
+    int multi_seams = 0;
+    double multi_percent = 0;
+    // 多分辨率模式：下采样层数（0 表示不使用）与细化时的带宽
+    int pyramid_levels = 0;
+    int pyramid_band = 4;
+    // 近似模式下同时逐条移除一遍，用于比较被移除的能量与耗时
+    bool compare_exact = false;
+    // 读取输入图像旁的 <图像>.seammap / 在输出目录写出 seam 移除顺序
+    bool use_map = false;
+    bool save_map = false;
+    // 流式模式：PPM 输入按行内存映射，只缩小宽度，内存不超过 memory_budget 字节
+    bool stream = false;
+    qint64 memory_budget = 256LL << 20;
+    // 保护/移除掩码图，所有输入共用，尺寸须与输入相同
+    QString protect_mask;
+    QString remove_mask;
+    // 混合模式：代价曲线越过拐点后停止移除 seam，剩余尺寸缩放完成
+    bool hybrid = false;
+    double knee = 2.0;
+};
+
+struct CarveStats {
+    int seams = 0;
+    // 混合模式中由缩放完成的像素数
+    int scaled = 0;
+    long long removed_energy = 0;
+    long long exact_energy = 0;
+    // 近似路径与精确路径移除 seam 的耗时
+    long long carve_nsecs = 0;
+    long long exact_nsecs = 0;
+};
+
+static const QStringList image_filters = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.ppm"};
+
+// 展开输入参数：目录取其中的图片文件，普通文件原样保留
+static QStringList collect_inputs(const QStringList &args, const QString &list_file) {
+    QStringList paths = args;
+    if (!list_file.isEmpty()) {
+        QFile file(list_file);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QTextStream in(&file);
+            while (!in.atEnd()) {
+                QString line = in.readLine().trimmed();
+                if (!line.isEmpty()) {
+                    paths.append(line);
+                }
+            }
+        } else {
+            std::fprintf(stderr, "cannot open file list %s\n", qPrintable(list_file));
+        }
+    }
+
+    QStringList files;
+    for (const QString &path : paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QDir dir(path);
+            for (const QFileInfo &entry : dir.entryInfoList(image_filters, QDir::Files, QDir::Name)) {
+                files.append(entry.filePath());
+            }
+        } else {
+            files.append(path);
+        }
+    }
+    return files;
+}
+
+static bool multi_seam_mode(const CarveOptions &options) {
+    return options.multi_seams > 1 || options.multi_percent > 0;
+}
+
+static bool masked_mode(const CarveOptions &options) {
+    return !options.protect_mask.isEmpty() || !options.remove_mask.isEmpty();
+}
+
+static bool approximate_mode(const CarveOptions &options) {
+    return multi_seam_mode(options) || options.pyramid_levels > 0;
+}
+
+static int seams_per_pass(const CarveOptions &options, int size) {
+    if (options.multi_percent > 0) {
+        return qMax(1, (int) (size * options.multi_percent / 100.0));
+    }
+    return qMax(1, options.multi_seams);
+}
+
+static void carve_direction(
+    QImage &image, int target, bool horizontal,
+    const CarveOptions &options, CarveStats &stats
+) {
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    find_kernels(options.op, kernelX, kernelY, window);
+
+    QElapsedTimer timer;
+    timer.start();
+    CarveSession session(image, kernelX, kernelY, window, horizontal);
+    session.set_pyramid(options.pyramid_levels, options.pyramid_band);
+    auto size = [&](const CarveSession &s) { return horizontal ? s.height() : s.width(); };
+    while (size(session) > target) {
+        const int k = qMin(seams_per_pass(options, size(session)), size(session) - target);
+        stats.seams += session.carve_multiple(k);
+    }
+    stats.removed_energy += session.removed_energy();
+    stats.carve_nsecs += timer.nsecsElapsed();
+
+    if (options.compare_exact && approximate_mode(options)) {
+        timer.restart();
+        CarveSession exact(image, kernelX, kernelY, window, horizontal);
+        while (size(exact) > target) {
+            exact.carve();
+        }
+        stats.exact_energy += exact.removed_energy();
+        stats.exact_nsecs += timer.nsecsElapsed();
+    }
+    image = session.result();
+}
+
+// 带掩码时逐条移除，先竖直后水平；移除区域在 --direction 所选的方向上移除干净，之后的放大与其他模式相同
+static bool carve_masked(
+    QImage &image, const QString &path, int target_width, int target_height,
+    const CarveOptions &options, CarveStats &stats
+) {
+    Plane<uchar> mask;
+    QString error;
+    const QImage protect = options.protect_mask.isEmpty() ? QImage() : QImage(options.protect_mask);
+    const QImage remove = options.remove_mask.isEmpty() ? QImage() : QImage(options.remove_mask);
+    if ((!options.protect_mask.isEmpty() && protect.isNull()) || (!options.remove_mask.isEmpty() && remove.isNull())) {
+        std::fprintf(stderr, "cannot read mask for %s\n", qPrintable(path));
+        return false;
+    }
+    if (!mask_from_images(protect, remove, image.width(), image.height(), mask, &error)) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(path), qPrintable(error));
+        return false;
+    }
+
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    find_kernels(options.op, kernelX, kernelY, window);
+    const bool remove_horizontally = options.horizontal && !options.vertical;
+    for (const bool horizontal : {false, true}) {
+        const int target = horizontal ? target_height : target_width;
+        CarveSession session(image, kernelX, kernelY, window, horizontal);
+        session.set_mask(mask);
+        auto size = [&]() { return horizontal ? session.height() : session.width(); };
+        while (size() > target || (horizontal == remove_horizontally && session.remove_left() > 0)) {
+            if (!session.carve()) {
+                std::fprintf(stderr, "%s: the protected region blocks every seam\n", qPrintable(path));
+                break;
+            }
+            stats.seams++;
+        }
+        stats.removed_energy += session.removed_energy();
+        image = session.result();
+        mask = session.current_mask();
+    }
+    return true;
+}
+
+// 只缩放一个方向时可以使用 seam 移除顺序；已处理时返回 true
+static bool carve_with_map(
+    QImage &image, const QString &path, int target, bool horizontal,
+    const CarveOptions &options, CarveStats &stats
+) {
+    const int size = horizontal ? image.height() : image.width();
+    SeamMap map;
+    if (options.use_map && load_seam_map(map, path + ".seammap") && map.op == options.op && map.horizontal == horizontal &&
+        map.width() == image.width() && map.height() == image.height() && target >= map.min_size()) {
+        image = retarget_with_seam_map(image, map, target);
+        stats.seams += size - target;
+        return true;
+    }
+    if (!options.save_map) {
+        return false;
+    }
+
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    find_kernels(options.op, kernelX, kernelY, window);
+    map = build_seam_map(image, kernelX, kernelY, window, horizontal);
+    map.op = options.op;
+    QString output = QDir(options.output_dir).filePath(QFileInfo(path).fileName()) + ".seammap";
+    if (!save_seam_map(map, output)) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(output));
+    }
+    image = retarget_with_seam_map(image, map, target);
+    stats.seams += map.seams;
+    return true;
+}
+
+// 流式模式不解码整张图像，只读取文件头得到尺寸
+static bool stream_file(const QString &path, const CarveOptions &options, CarveStats &stats) {
+    int width = 0;
+    int height = 0;
+    if (!read_ppm_header(path, width, height)) {
+        std::fprintf(stderr, "--stream needs a binary 8-bit PPM: %s\n", qPrintable(path));
+        return false;
+    }
+    int target_width = width;
+    if (options.ratio > 0 && options.vertical) {
+        target_width = (int) (width * options.ratio);
+    }
+    if (options.width > 0) {
+        target_width = options.width;
+    }
+    target_width = qMax(1, target_width);
+    if (target_width > width || (options.height > 0 && options.height != height) ||
+        (options.ratio > 0 && options.horizontal && (int) (height * options.ratio) != height)) {
+        std::fprintf(stderr, "--stream can only reduce the width: %s\n", qPrintable(path));
+        return false;
+    }
+
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    find_kernels(options.op, kernelX, kernelY, window);
+    StreamOptions stream_options;
+    stream_options.memory_budget = options.memory_budget;
+    QString output = QDir(options.output_dir).filePath(QFileInfo(path).fileName());
+    QString error;
+    if (!stream_carve(path, output, target_width, kernelX, kernelY, window, stream_options, &stats.removed_energy, &error)) {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return false;
+    }
+    stats.seams += width - target_width;
+    return true;
+}
+
+static bool carve_file(const QString &path, const CarveOptions &options, CarveStats &stats) {
+    if (options.stream) {
+        return stream_file(path, options, stats);
+    }
+    QImage image(path);
+    if (image.isNull()) {
+        std::fprintf(stderr, "cannot read %s\n", qPrintable(path));
+        return false;
+    }
+
+    int target_width = image.width();
+    int target_height = image.height();
+    if (options.ratio > 0) {
+        if (options.vertical) {
+            target_width = (int) (image.width() * options.ratio);
+        }
+        if (options.horizontal) {
+            target_height = (int) (image.height() * options.ratio);
+        }
+    }
+    if (options.width > 0) {
+        target_width = options.width;
+    }
+    if (options.height > 0) {
+        target_height = options.height;
+    }
+    target_width = qMax(1, target_width);
+    target_height = qMax(1, target_height);
+
+    const bool carve_width = image.width() > target_width;
+    const bool carve_height = image.height() > target_height;
+    if (masked_mode(options)) {
+        if (!carve_masked(image, path, target_width, target_height, options, stats)) {
+            return false;
+        }
+    } else if (options.hybrid && (carve_width || carve_height)) {
+        const Kernel *kernelX = nullptr;
+        const Kernel *kernelY = nullptr;
+        WindowEnergy window = WindowEnergy::None;
+        find_kernels(options.op, kernelX, kernelY, window);
+        HybridOptions hybrid_options;
+        hybrid_options.knee = options.knee;
+        HybridStats hybrid_stats;
+        image = hybrid_retarget(image, target_width, target_height, kernelX, kernelY, window, hybrid_options, &hybrid_stats);
+        stats.seams += hybrid_stats.seams[0] + hybrid_stats.seams[1];
+        stats.scaled += hybrid_stats.scaled[0] + hybrid_stats.scaled[1];
+        stats.removed_energy += hybrid_stats.removed;
+    } else if ((options.use_map || options.save_map) && carve_width != carve_height &&
+        carve_with_map(image, path, carve_width ? target_width : target_height, carve_height, options, stats)) {
+        // 已通过 seam 移除顺序完成
+    } else if (carve_width && carve_height && !approximate_mode(options)) {
+        // 两个方向都要缩小时按贪心顺序交替移除
+        const Kernel *kernelX = nullptr;
+        const Kernel *kernelY = nullptr;
+        WindowEnergy window = WindowEnergy::None;
+        find_kernels(options.op, kernelX, kernelY, window);
+        long long removed = 0;
+        stats.seams += image.width() - target_width + image.height() - target_height;
+        image = retarget_2d(image, target_width, target_height, kernelX, kernelY, window, &removed);
+        stats.removed_energy += removed;
+    } else {
+        if (carve_width) {
+            carve_direction(image, target_width, false, options, stats);
+        }
+        if (carve_height) {
+            carve_direction(image, target_height, true, options, stats);
+        }
+    }
+
+    // 目标尺寸大于原图时插入 seam
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    find_kernels(options.op, kernelX, kernelY, window);
+    if (image.width() < target_width) {
+        stats.seams += target_width - image.width();
+        image = insert_seams(image, target_width - image.width(), kernelX, kernelY, window, false);
+    }
+    if (image.height() < target_height) {
+        stats.seams += target_height - image.height();
+        image = insert_seams(image, target_height - image.height(), kernelX, kernelY, window, true);
+    }
+
+    QString output = QDir(options.output_dir).filePath(QFileInfo(path).fileName());
+    if (!image.save(output)) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(output));
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("seam-carving-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Batch content-aware image retargeting.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Image files or directories to process.", "[inputs...]");
+    QCommandLineOption list_option({"l", "file-list"}, "Read input paths from <file>, one per line.", "file");
+    QCommandLineOption output_option({"o", "output-dir"}, "Directory for the carved images.", "dir");
+    QCommandLineOption width_option({"W", "width"}, "Target width in pixels.", "pixels");
+    QCommandLineOption height_option({"H", "height"}, "Target height in pixels.", "pixels");
+    QCommandLineOption ratio_option({"r", "ratio"}, "Scale factor for the size, e.g. 0.5 to shrink or 1.2 to enlarge.", "ratio");
+    QCommandLineOption direction_option({"d", "direction"}, "Direction for --ratio: vertical, horizontal or both.", "direction", "vertical");
+    QCommandLineOption operator_option({"p", "operator"}, "Energy operator: Sobel, Prewitt, Scharr, Roberts, HoG, Entropy or Forward.", "name", "Sobel");
+    QCommandLineOption threads_option({"j", "threads"}, "Number of worker threads.", "n", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption multi_option({"m", "multi-seam"}, "Approximate mode: remove <k> seams per pass, or <p>% of the current size.", "k");
+    QCommandLineOption pyramid_option("pyramid", "Approximate mode: search seams on a pyramid <levels> deep and refine them at full resolution.", "levels");
+    QCommandLineOption band_option("band", "With --pyramid, pixels searched on each side of the projected seam.", "pixels", "4");
+    QCommandLineOption compare_option("compare-exact", "With --multi-seam or --pyramid, also run the exact path and report the removed-energy and time delta.");
+    QCommandLineOption save_map_option("save-map", "Carve down to one column/row once and write the removal order to <output>.seammap.");
+    QCommandLineOption use_map_option("use-map", "Retarget from <input>.seammap when it exists and matches the image, direction and --operator.");
+    QCommandLineOption stream_option("stream", "Out-of-core mode for binary PPM files too large for memory: map rows from disk and reduce the width only.");
+    QCommandLineOption memory_option("memory", "With --stream, memory budget in MiB.", "MiB", "256");
+    QCommandLineOption protect_option("protect", "Mask image of regions no seam may cross (bright opaque pixels).", "file");
+    QCommandLineOption remove_option("remove", "Mask image of an object to carve away along --direction; the output still has the target size, which defaults to the input size.", "file");
+    QCommandLineOption hybrid_option("hybrid", "Carve only until the seam cost curve bends upward, then scale the rest of the reduction.");
+    QCommandLineOption knee_option("knee", "With --hybrid, switch to scaling once recent seams cost <ratio> times the earlier average.", "ratio", "2");
+    QCommandLineOption trace_option("trace", "Write a Chrome/Perfetto trace of the hot paths to <file>.", "file");
+    parser.addOptions({list_option, output_option, width_option, height_option, ratio_option,
+                       direction_option, operator_option, threads_option, multi_option,
+                       pyramid_option, band_option, compare_option,
+                       save_map_option, use_map_option, stream_option, memory_option,
+                       protect_option, remove_option, hybrid_option, knee_option, trace_option});
+    parser.process(app);
+
+    CarveOptions options;
+    options.op = parser.value(operator_option);
+    options.output_dir = parser.value(output_option);
+    options.width = parser.value(width_option).toInt();
+    options.height = parser.value(height_option).toInt();
+    options.ratio = parser.value(ratio_option).toDouble();
+    const QString direction = parser.value(direction_option).toLower();
+    options.vertical = direction == "vertical" || direction == "both";
+    options.horizontal = direction == "horizontal" || direction == "both";
+    QString multi = parser.value(multi_option);
+    if (multi.endsWith("%")) {
+        multi.chop(1);
+        options.multi_percent = multi.toDouble();
+    } else {
+        options.multi_seams = multi.toInt();
+    }
+    options.pyramid_levels = qMax(0, parser.value(pyramid_option).toInt());
+    options.pyramid_band = qMax(0, parser.value(band_option).toInt());
+    options.compare_exact = parser.isSet(compare_option);
+    options.save_map = parser.isSet(save_map_option);
+    options.use_map = parser.isSet(use_map_option);
+    options.stream = parser.isSet(stream_option);
+    options.memory_budget = qMax(1, parser.value(memory_option).toInt()) * (1LL << 20);
+    options.protect_mask = parser.value(protect_option);
+    options.remove_mask = parser.value(remove_option);
+    options.hybrid = parser.isSet(hybrid_option);
+    options.knee = parser.value(knee_option).toDouble();
+
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    if (options.op != "Forward" && !find_kernels(options.op, kernelX, kernelY, window)) {
+        std::fprintf(stderr, "unknown operator %s\n", qPrintable(options.op));
+        return 1;
+    }
+    if (!options.vertical && !options.horizontal) {
+        std::fprintf(stderr, "unknown direction %s\n", qPrintable(direction));
+        return 1;
+    }
+    if (options.stream && masked_mode(options)) {
+        std::fprintf(stderr, "--stream does not support --protect or --remove\n");
+        return 1;
+    }
+    if (options.hybrid && (options.stream || masked_mode(options))) {
+        std::fprintf(stderr, "--hybrid does not support --stream, --protect or --remove\n");
+        return 1;
+    }
+    if (options.hybrid && options.knee <= 1) {
+        std::fprintf(stderr, "--knee must be greater than 1\n");
+        return 1;
+    }
+    if (options.output_dir.isEmpty()) {
+        std::fprintf(stderr, "--output-dir is required\n");
+        return 1;
+    }
+    if (options.width <= 0 && options.height <= 0 && options.ratio <= 0 && options.remove_mask.isEmpty()) {
+        std::fprintf(stderr, "one of --width, --height, --ratio or --remove is required\n");
+        return 1;
+    }
+    QDir().mkpath(options.output_dir);
+
+    const QStringList files = collect_inputs(parser.positionalArguments(), parser.value(list_option));
+    if (files.isEmpty()) {
+        std::fprintf(stderr, "no input images\n");
+        return 1;
+    }
+
+    if (parser.isSet(trace_option) && !trace_start(parser.value(trace_option).toStdString())) {
+        std::fprintf(stderr, "tracing is already enabled by SEAM_CARVER_TRACE\n");
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, parser.value(threads_option).toInt()));
+
+    std::atomic<long long> total_seams{0};
+    std::atomic<long long> total_scaled{0};
+    std::atomic<long long> removed_energy{0};
+    std::atomic<long long> exact_energy{0};
+    std::atomic<long long> carve_nsecs{0};
+    std::atomic<long long> exact_nsecs{0};
+    std::atomic<int> done{0};
+    std::atomic<int> failed{0};
+
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &file : files) {
+        pool.start([&, file]() {
+            CarveStats stats;
+            if (!carve_file(file, options, stats)) {
+                failed++;
+                return;
+            }
+            total_seams += stats.seams;
+            total_scaled += stats.scaled;
+            removed_energy += stats.removed_energy;
+            exact_energy += stats.exact_energy;
+            carve_nsecs += stats.carve_nsecs;
+            exact_nsecs += stats.exact_nsecs;
+            done++;
+        });
+    }
+    pool.waitForDone();
+    const double seconds = qMax(timer.nsecsElapsed() / 1e9, 1e-9);
+
+    std::printf("images: %d ok, %d failed, %d threads\n", done.load(), failed.load(), pool.maxThreadCount());
+    std::printf("elapsed: %.3f s\n", seconds);
+    std::printf("images/sec: %.3f\n", done.load() / seconds);
+    std::printf("seams/sec: %.1f\n", total_seams.load() / seconds);
+    std::printf("removed energy: %lld\n", removed_energy.load());
+    if (options.hybrid) {
+        std::printf("seams: %lld carved, %lld pixels scaled\n", total_seams.load(), total_scaled.load());
+    }
+    if (options.compare_exact && approximate_mode(options)) {
+        const long long delta = removed_energy.load() - exact_energy.load();
+        std::printf("exact removed energy: %lld\n", exact_energy.load());
+        std::printf("quality delta: %+lld (%+.2f%%)\n", delta,
+                    100.0 * delta / qMax(1LL, exact_energy.load()));
+        std::printf("carve time: %.3f s approximate, %.3f s exact (%.2fx)\n",
+                    carve_nsecs.load() / 1e9, exact_nsecs.load() / 1e9,
+                    (double) exact_nsecs.load() / qMax(1LL, carve_nsecs.load()));
+    }
+    if (parser.isSet(trace_option) && !trace_stop()) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(trace_option)));
+    }
+    return failed.load() == 0 ? 0 : 2;
+}
@@ -0,0 +1,340 @@
+#include "seam_carver.h"
+#include "seam_insertion.h"
+#include "retarget_cache.h"
+#include "trace.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QThreadPool>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+// 请求体（编码后的图像）的上限
+static const qint64 max_body_bytes = 256LL << 20;
+// 计算延迟分位数时保留的最近请求数
+static const int latency_window = 4096;
+
+// 最近 latency_window 个请求的处理时间（毫秒），从读完请求到生成响应，包括在线程池中排队的时间
+class LatencyWindow
+{
+public:
+    void add(double ms) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ((int) samples.size() < latency_window) {
+            samples.push_back(ms);
+        } else {
+            samples[next] = ms;
+        }
+        next = (next + 1) % latency_window;
+        count++;
+    }
+
+    QJsonObject percentiles() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        auto at = [&](double p) {
+            return sorted.empty() ? 0.0 : sorted[qMin((int) sorted.size() - 1, (int) (p * sorted.size()))];
+        };
+        QJsonObject result;
+        result["requests"] = count;
+        result["p50"] = at(0.50);
+        result["p90"] = at(0.90);
+        result["p99"] = at(0.99);
+        result["max"] = sorted.empty() ? 0.0 : sorted.back();
+        return result;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<double> samples;
+    int next = 0;
+    qint64 count = 0;
+};
+
+struct Response {
+    int status = 200;
+    QByteArray type = "text/plain";
+    QByteArray body;
+};
+
+static Response error_response(int status, const QString &message) {
+    Response response;
+    response.status = status;
+    response.body = message.toUtf8() + "\n";
+    return response;
+}
+
+static QByteArray status_text(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Internal Server Error";
+    }
+}
+
+class Server
+{
+public:
+    // 同时处理与排队的请求至多 max_pending 个，超出时直接回复 503，不占用内存排队
+    Server(qint64 cache_bytes, int threads, int max_pending) : cache(cache_bytes), max_pending(qMax(1, max_pending)) {
+        pool.setMaxThreadCount(qMax(1, threads));
+    }
+
+    // 每个连接只处理一个请求，写出响应后关闭；Unix socket 与 TCP 使用相同的 HTTP 协议
+    void accept(QIODevice *socket) {
+        QByteArray *buffer = new QByteArray();
+        QObject::connect(socket, &QObject::destroyed, [buffer]() { delete buffer; });
+        QObject::connect(socket, &QIODevice::readyRead, [this, socket, buffer]() {
+            buffer->append(socket->readAll());
+            read_request(socket, *buffer);
+        });
+    }
+
+private:
+    RetargetCache cache;
+    LatencyWindow latency;
+    QThreadPool pool;
+    const int max_pending;
+    // 已交给线程池、还没有处理完的请求数
+    std::atomic<int> pending{0};
+
+    void read_request(QIODevice *socket, QByteArray &buffer) {
+        const int header_end = buffer.indexOf("\r\n\r\n");
+        if (header_end < 0) {
+            if (buffer.size() > 64 * 1024) {
+                reply(socket, error_response(400, "header too large"));
+            }
+            return;
+        }
+        const QList<QByteArray> lines = buffer.left(header_end).split('\n');
+        const QList<QByteArray> request_line = lines[0].trimmed().split(' ');
+        if (request_line.size() < 2) {
+            reply(socket, error_response(400, "malformed request line"));
+            return;
+        }
+        qint64 length = 0;
+        for (int i = 1; i < lines.size(); i++) {
+            const int colon = lines[i].indexOf(':');
+            if (colon > 0 && lines[i].left(colon).trimmed().toLower() == "content-length") {
+                length = lines[i].mid(colon + 1).trimmed().toLongLong();
+            }
+        }
+        if (length < 0 || length > max_body_bytes) {
+            reply(socket, error_response(413, "image too large"));
+            return;
+        }
+        if (buffer.size() - header_end - 4 < length) {
+            return;
+        }
+        // 请求已完整，之后的数据忽略
+        QElapsedTimer timer;
+        timer.start();
+        QObject::disconnect(socket, &QIODevice::readyRead, nullptr, nullptr);
+        const QByteArray method = request_line[0];
+        const QUrl url(QString::fromLatin1(request_line[1]));
+        const QByteArray body = buffer.mid(header_end + 4, length);
+        buffer.clear();
+
+        if (pending.fetch_add(1) >= max_pending) {
+            pending--;
+            reply(socket, error_response(503, "server busy, retry later"));
+            return;
+        }
+        QPointer<QIODevice> target(socket);
+        pool.start([this, target, method, url, body, timer]() {
+            Response response = handle(method, url, body);
+            latency.add(timer.nsecsElapsed() / 1e6);
+            pending--;
+            // 回到 socket 所在的线程写出，连接可能已经断开
+            QMetaObject::invokeMethod(qApp, [this, target, response]() {
+                if (target) {
+                    reply(target, response);
+                }
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    // 每个连接只响应一次，出错时请求可能还没有读完，先停止读取
+    void reply(QIODevice *socket, const Response &response) {
+        QObject::disconnect(socket, &QIODevice::readyRead, nullptr, nullptr);
+        QByteArray head = "HTTP/1.1 " + QByteArray::number(response.status) + " " + status_text(response.status) + "\r\n";
+        head += "Content-Type: " + response.type + "\r\n";
+        head += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+        head += "Connection: close\r\n\r\n";
+        socket->write(head);
+        socket->write(response.body);
+        if (QTcpSocket *tcp = qobject_cast<QTcpSocket *>(socket)) {
+            tcp->disconnectFromHost();
+        } else if (QLocalSocket *local = qobject_cast<QLocalSocket *>(socket)) {
+            local->disconnectFromServer();
+        }
+    }
+
+    Response handle(const QByteArray &method, const QUrl &url, const QByteArray &body) {
+        if (url.path() == "/stats") {
+            if (method != "GET") {
+                return error_response(405, "GET /stats");
+            }
+            return stats();
+        }
+        if (url.path() != "/retarget") {
+            return error_response(404, "unknown path " + url.path());
+        }
+        if (method != "POST") {
+            return error_response(405, "POST the image to /retarget");
+        }
+        return retarget(QUrlQuery(url), body);
+    }
+
+    // POST /retarget?width=W&height=H&operator=Sobel&format=png，请求体为编码后的图像
+    Response retarget(const QUrlQuery &query, const QByteArray &body) {
+        SEAM_CARVER_TRACE_SCOPE("request");
+        const QImage image = QImage::fromData(body);
+        if (image.isNull()) {
+            return error_response(400, "cannot decode the image");
+        }
+        const QString op = query.hasQueryItem("operator") ? query.queryItemValue("operator") : QString("Sobel");
+        const Kernel *kernelX = nullptr;
+        const Kernel *kernelY = nullptr;
+        WindowEnergy window = WindowEnergy::None;
+        if (op != "Forward" && !find_kernels(op, kernelX, kernelY, window)) {
+            return error_response(400, "unknown operator " + op);
+        }
+        const int width = query.hasQueryItem("width") ? query.queryItemValue("width").toInt() : image.width();
+        const int height = query.hasQueryItem("height") ? query.queryItemValue("height").toInt() : image.height();
+        if (width <= 0 || height <= 0) {
+            return error_response(400, "width and height must be positive");
+        }
+        const QByteArray format = query.hasQueryItem("format") ? query.queryItemValue("format").toLatin1().toUpper() : QByteArray("PNG");
+
+        // 先缩小宽度，再在结果上缩小高度；第二步以第一步的输入与宽度为键，重复的请求同样命中
+        const QByteArray key = QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex();
+        QImage output = cache.retarget(key, image, op, false, width);
+        if (output.height() > height) {
+            output = cache.retarget(key + "@" + QByteArray::number(output.width()), output, op, true, height);
+        }
+        // 放大不缓存
+        if (output.width() < width) {
+            output = insert_seams(output, width - output.width(), kernelX, kernelY, window, false);
+        }
+        if (output.height() < height) {
+            output = insert_seams(output, height - output.height(), kernelX, kernelY, window, true);
+        }
+
+        Response response;
+        QBuffer buffer(&response.body);
+        buffer.open(QIODevice::WriteOnly);
+        if (!output.save(&buffer, format.constData())) {
+            return error_response(400, "cannot encode " + QString::fromLatin1(format));
+        }
+        response.type = "image/" + format.toLower();
+        return response;
+    }
+
+    // GET /stats：缓存命中情况、在途请求数与最近请求的延迟分位数（毫秒）
+    Response stats() {
+        const RetargetCache::Stats s = cache.stats();
+        QJsonObject object;
+        object["hits"] = s.hits;
+        object["partial"] = s.partial;
+        object["misses"] = s.misses;
+        object["evictions"] = s.evictions;
+        object["entries"] = s.entries;
+        object["bytes"] = s.bytes;
+        object["capacity"] = s.capacity;
+        object["pending"] = pending.load();
+        object["latency_ms"] = latency.percentiles();
+        Response response;
+        response.type = "application/json";
+        response.body = QJsonDocument(object).toJson();
+        return response;
+    }
+};
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("seam-carving-server");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Local retargeting server. POST an image to /retarget?width=W&height=H&operator=Sobel&format=png; "
+        "GET /stats for cache and latency counters.");
+    parser.addHelpOption();
+    QCommandLineOption port_option("port", "Listen on localhost:<port>.", "port", "8080");
+    QCommandLineOption socket_option("socket", "Listen on the Unix socket <path> instead of TCP (combine with --port for both).", "path");
+    QCommandLineOption cache_option("cache", "Cache size in MiB.", "MiB", "512");
+    QCommandLineOption threads_option({"j", "threads"}, "Number of request threads.", "n", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption pending_option("max-pending", "Requests in flight (running or queued) before replying 503. Defaults to 4 per thread.", "n");
+    QCommandLineOption trace_option("trace", "Write a Chrome/Perfetto trace of the hot paths to <file> on exit.", "file");
+    parser.addOptions({port_option, socket_option, cache_option, threads_option, pending_option, trace_option});
+    parser.process(app);
+
+    if (parser.isSet(trace_option) && !trace_start(parser.value(trace_option).toStdString())) {
+        std::fprintf(stderr, "tracing is already enabled by SEAM_CARVER_TRACE\n");
+    }
+
+    const int threads = qMax(1, parser.value(threads_option).toInt());
+    const int max_pending = parser.isSet(pending_option) ? parser.value(pending_option).toInt() : 4 * threads;
+    Server server(qMax(1, parser.value(cache_option).toInt()) * (1LL << 20), threads, max_pending);
+
+    QTcpServer tcp;
+    QLocalServer local;
+    if (parser.isSet(socket_option)) {
+        const QString path = parser.value(socket_option);
+        QLocalServer::removeServer(path);
+        if (!local.listen(path)) {
+            std::fprintf(stderr, "cannot listen on %s: %s\n", qPrintable(path), qPrintable(local.errorString()));
+            return 1;
+        }
+        QObject::connect(&local, &QLocalServer::newConnection, [&]() {
+            while (QLocalSocket *socket = local.nextPendingConnection()) {
+                QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+                server.accept(socket);
+            }
+        });
+        std::fprintf(stderr, "listening on %s\n", qPrintable(path));
+    }
+    if (!parser.isSet(socket_option) || parser.isSet(port_option)) {
+        const quint16 port = parser.value(port_option).toUShort();
+        if (!tcp.listen(QHostAddress::LocalHost, port)) {
+            std::fprintf(stderr, "cannot listen on localhost:%d: %s\n", port, qPrintable(tcp.errorString()));
+            return 1;
+        }
+        QObject::connect(&tcp, &QTcpServer::newConnection, [&]() {
+            while (QTcpSocket *socket = tcp.nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+                server.accept(socket);
+            }
+        });
+        std::fprintf(stderr, "listening on localhost:%d\n", tcp.serverPort());
+    }
+
+    const int status = app.exec();
+    if (parser.isSet(trace_option) && !trace_stop()) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(trace_option)));
+    }
+    return status;
+}
@@ -0,0 +1,91 @@
+#include "seam_carver.h"
+#include "video_carver.h"
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+
+#include <cstdio>
+
+// 以 "-" 表示标准输入输出
+static bool open_stream(QFile &file, const QString &path, bool write) {
+    if (path == "-") {
+        return file.open(write ? stdout : stdin, write ? QIODevice::WriteOnly : QIODevice::ReadOnly);
+    }
+    file.setFileName(path);
+    return file.open(write ? QIODevice::WriteOnly : QIODevice::ReadOnly);
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("seam-carving-video");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Temporally coherent seam carving for Y4M video.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Input Y4M file, or - for stdin.");
+    parser.addPositionalArgument("output", "Output Y4M file, or - for stdout.");
+    QCommandLineOption width_option({"W", "width"}, "Target width in pixels.", "pixels");
+    QCommandLineOption height_option({"H", "height"}, "Target height in pixels.", "pixels");
+    QCommandLineOption operator_option({"p", "operator"}, "Energy operator: Sobel, Prewitt, Scharr, Roberts, HoG, Entropy or Forward.", "name", "Sobel");
+    QCommandLineOption band_option("band", "Pixels searched on each side of the previous frame's seam.", "pixels", "8");
+    QCommandLineOption keyframe_option("keyframe", "Search seams over the whole frame every <n> frames (0: first frame only).", "n", "0");
+    QCommandLineOption queue_option("queue", "Frames buffered between the decode, carve and encode threads.", "n", "4");
+    QCommandLineOption trace_option("trace", "Write a Chrome/Perfetto trace of the hot paths to <file>.", "file");
+    parser.addOptions({width_option, height_option, operator_option, band_option, keyframe_option, queue_option, trace_option});
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 2) {
+        std::fprintf(stderr, "expected an input and an output\n");
+        return 1;
+    }
+    VideoOptions options;
+    options.width = parser.value(width_option).toInt();
+    options.height = parser.value(height_option).toInt();
+    options.band = qMax(0, parser.value(band_option).toInt());
+    options.keyframe_interval = qMax(0, parser.value(keyframe_option).toInt());
+    options.queue_frames = qMax(1, parser.value(queue_option).toInt());
+    const QString op = parser.value(operator_option);
+    if (op != "Forward" && !find_kernels(op, options.kernelX, options.kernelY, options.window)) {
+        std::fprintf(stderr, "unknown operator %s\n", qPrintable(op));
+        return 1;
+    }
+    if (options.width <= 0 && options.height <= 0) {
+        std::fprintf(stderr, "one of --width or --height is required\n");
+        return 1;
+    }
+
+    QFile input;
+    QFile output;
+    if (!open_stream(input, args[0], false)) {
+        std::fprintf(stderr, "cannot read %s\n", qPrintable(args[0]));
+        return 1;
+    }
+    if (!open_stream(output, args[1], true)) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(args[1]));
+        return 1;
+    }
+    if (parser.isSet(trace_option) && !trace_start(parser.value(trace_option).toStdString())) {
+        std::fprintf(stderr, "tracing is already enabled by SEAM_CARVER_TRACE\n");
+    }
+
+    VideoStats stats;
+    QString error;
+    const bool ok = carve_video(input, output, options, &stats, &error);
+    // 输出可能是标准输出，统计信息写到标准错误
+    std::fprintf(stderr, "frames: %d at %dx%d\n", stats.frames, stats.width, stats.height);
+    std::fprintf(stderr, "decode: %.3f s, carve: %.3f s, encode: %.3f s\n",
+                 stats.decode_seconds, stats.carve_seconds, stats.encode_seconds);
+    std::fprintf(stderr, "carve fps: %.1f\n", stats.frames / qMax(stats.carve_seconds, 1e-9));
+    std::fprintf(stderr, "removed energy: %lld\n", stats.removed_energy);
+    if (parser.isSet(trace_option) && !trace_stop()) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(trace_option)));
+    }
+    if (!ok) {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 2;
+    }
+    return 0;
+}
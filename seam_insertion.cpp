@@ -0,0 +1,84 @@
+#include "seam_insertion.h"
+#include "carve_session.h"
+#include "image_plane.h"
+#include "pixel_plane.h"
+
+#include <vector>
+
+// 在原图上插入至多 k 条 seam，k 须小于 seam 方向上的尺寸；实际插入的条数写入 inserted
+static QImage insert_seams_once(
+    const QImage &image, int k,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    bool horizontal, int &inserted
+) {
+    // 先成批找出将被移除的 k 条 seam，移除顺序 < k 的像素就是要复制的像素
+    CarveSession session(image, kernelX, kernelY, window, horizontal);
+    session.record_removal_order();
+    while (session.seams_removed() < k) {
+        if (session.carve_multiple(k - session.seams_removed()) == 0) {
+            break;
+        }
+    }
+    const Plane<quint32> &order = session.removal_order();
+
+    const PixelPlane pixels(image);
+    const int col = pixels.width();
+    const int row = pixels.height();
+    inserted = session.seams_removed();
+    PixelPlane output = horizontal ? pixels.blank(col, row + inserted) : pixels.blank(col + inserted, row);
+    pixels.visit([&](const auto &source) {
+        typedef plane_pixel_t<decltype(source)> P;
+        Plane<P> &target = output.get<P>();
+        if (horizontal) {
+            // next[x] 为第 x 列下一个输出行
+            std::vector<int> next(col, 0);
+            for (int y = 0; y < row; y++) {
+                const quint32 *o = order.row(y);
+                const P *src = source.row(y);
+                const P *below = source.row(qMin(row - 1, y + 1));
+                for (int x = 0; x < col; x++) {
+                    target.at(x, next[x]++) = src[x];
+                    if (o[x] < (quint32) inserted) {
+                        target.at(x, next[x]++) = pixel_average(src[x], below[x]);
+                    }
+                }
+            }
+        } else {
+            for (int y = 0; y < row; y++) {
+                const quint32 *o = order.row(y);
+                const P *src = source.row(y);
+                P *dst = target.row(y);
+                for (int x = 0; x < col; x++) {
+                    *dst++ = src[x];
+                    if (o[x] < (quint32) inserted) {
+                        *dst++ = pixel_average(src[x], src[qMin(col - 1, x + 1)]);
+                    }
+                }
+            }
+        }
+    });
+    return output.to_image();
+}
+
+QImage insert_seams(
+    const QImage &image, int k,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    bool horizontal
+) {
+    QImage output = image;
+    while (k > 0) {
+        const int size = horizontal ? output.height() : output.width();
+        const int step = qMin(k, qMax(1, size / 2));
+        if (size <= 1) {
+            break;
+        }
+        int inserted = 0;
+        output = insert_seams_once(output, step, kernelX, kernelY, window, horizontal, inserted);
+        // 一条也插不进去时停止，避免空转
+        if (inserted == 0) {
+            break;
+        }
+        k -= inserted;
+    }
+    return output;
+}
@@ -0,0 +1,17 @@
+#ifndef SEAM_INSERTION_H
+#define SEAM_INSERTION_H
+
+#include "seam_carver.h"
+
+#include <QImage>
+
+// 内容感知放大：在原图上成批找出 k 条能量最低的互不相交的 seam，
+// 再一遍写出结果，每条 seam 上的像素后面插入它与下一个像素的平均值
+// 竖直 seam 增加宽度，水平 seam 增加高度；k 超过当前尺寸的一半时分多轮插入，避免反复拉伸同一区域
+QImage insert_seams(
+    const QImage &image, int k,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    bool horizontal = false
+);
+
+#endif // SEAM_INSERTION_H
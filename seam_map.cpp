@@ -0,0 +1,226 @@
+#include "seam_map.h"
+#include "carve_session.h"
+#include "pixel_plane.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QtEndian>
+
+#include <cstring>
+#include <vector>
+
+static const char seam_map_magic[4] = {'S', 'C', 'M', 'P'};
+// 版本 2 加入算子名称
+static const quint16 seam_map_version = 2;
+static const quint16 seam_map_horizontal = 1;
+static const quint16 seam_map_wide = 2;
+// 宽与高的上限，保证一行的字节数不超过 int
+static const quint32 seam_map_max_side = 1 << 20;
+
+SeamMap build_seam_map(
+    const QImage &image,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    bool horizontal, int max_seams,
+    const std::function<void(int, int)> &progress,
+    const std::atomic<bool> *cancel
+) {
+    CarveSession session(image, kernelX, kernelY, window, horizontal);
+    const int size = horizontal ? image.height() : image.width();
+    const int total = max_seams < 0 ? size - 1 : qMin(max_seams, size - 1);
+    session.record_removal_order();
+    for (int i = 0; i < total; i++) {
+        if (cancel != nullptr && *cancel) {
+            return SeamMap();
+        }
+        session.carve();
+        if (progress) {
+            progress(i + 1, total);
+        }
+    }
+
+    return seam_map_from_order(session.removal_order(), total, horizontal);
+}
+
+SeamMap seam_map_from_order(const Plane<quint32> &order, int seams, bool horizontal) {
+    SeamMap map;
+    map.horizontal = horizontal;
+    map.seams = seams;
+    map.order = order;
+    for (int y = 0; y < map.height(); y++) {
+        quint32 *o = map.order.row(y);
+        for (int x = 0; x < map.width(); x++) {
+            o[x] = qMin(o[x], (quint32) seams);
+        }
+    }
+    return map;
+}
+
+QImage retarget_with_seam_map(const QImage &image, const SeamMap &map, int size) {
+    if (map.isNull() || image.width() != map.width() || image.height() != map.height()) {
+        return QImage();
+    }
+    const int original = map.horizontal ? map.height() : map.width();
+    size = qBound(map.min_size(), size, original);
+    // 保留移除序号 >= n 的像素
+    const quint32 n = original - size;
+
+    const PixelPlane pixels(image);
+    PixelPlane output = map.horizontal ? pixels.blank(map.width(), size) : pixels.blank(size, map.height());
+    pixels.visit([&](const auto &source) {
+        typedef plane_pixel_t<decltype(source)> P;
+        Plane<P> &target = output.get<P>();
+        if (map.horizontal) {
+            // next[x] 为第 x 列下一个输出行
+            std::vector<int> next(map.width(), 0);
+            for (int y = 0; y < map.height(); y++) {
+                const quint32 *o = map.order.row(y);
+                const P *src = source.row(y);
+                for (int x = 0; x < map.width(); x++) {
+                    if (o[x] >= n && next[x] < size) {
+                        target.at(x, next[x]++) = src[x];
+                    }
+                }
+            }
+        } else {
+            for (int y = 0; y < map.height(); y++) {
+                const quint32 *o = map.order.row(y);
+                const P *src = source.row(y);
+                P *dst = target.row(y);
+                const P *end = dst + size;
+                for (int x = 0; x < map.width() && dst < end; x++) {
+                    if (o[x] >= n) {
+                        *dst++ = src[x];
+                    }
+                }
+            }
+        }
+    });
+    return output.to_image();
+}
+
+bool save_seam_map(const SeamMap &map, const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    const bool wide = map.seams >= 0xFFFF;
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(seam_map_magic, sizeof(seam_map_magic));
+    out << seam_map_version
+        << (quint16) ((map.horizontal ? seam_map_horizontal : 0) | (wide ? seam_map_wide : 0))
+        << (quint32) map.width() << (quint32) map.height() << (quint32) map.seams;
+    const QByteArray op = map.op.toLatin1();
+    out << (quint16) op.size();
+    out.writeRawData(op.constData(), op.size());
+
+    std::vector<quint16> narrow_line(map.width());
+    std::vector<quint32> wide_line(map.width());
+    for (int y = 0; y < map.height(); y++) {
+        const quint32 *o = map.order.row(y);
+        if (wide) {
+            qToLittleEndian<quint32>(o, map.width(), wide_line.data());
+            out.writeRawData(reinterpret_cast<const char *>(wide_line.data()), map.width() * sizeof(quint32));
+        } else {
+            for (int x = 0; x < map.width(); x++) {
+                narrow_line[x] = qToLittleEndian((quint16) o[x]);
+            }
+            out.writeRawData(reinterpret_cast<const char *>(narrow_line.data()), map.width() * sizeof(quint16));
+        }
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+// 每行（水平 seam 时每列）中 0 ~ seams - 1 须各出现一次，其余像素为 seams
+static bool valid_order(const SeamMap &map) {
+    const int lines = map.horizontal ? map.width() : map.height();
+    const int length = map.horizontal ? map.height() : map.width();
+    // seen[k] == line + 1 表示第 line 条线上已经出现过序号 k
+    std::vector<int> seen(map.seams, 0);
+    for (int i = 0; i < lines; i++) {
+        int removed = 0;
+        for (int j = 0; j < length; j++) {
+            const quint32 k = map.horizontal ? map.order.at(i, j) : map.order.at(j, i);
+            if (k > (quint32) map.seams) {
+                return false;
+            }
+            if (k < (quint32) map.seams) {
+                if (seen[k] == i + 1) {
+                    return false;
+                }
+                seen[k] = i + 1;
+                removed++;
+            }
+        }
+        if (removed != map.seams) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool load_seam_map(SeamMap &map, const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    char magic[4];
+    quint16 version = 0;
+    quint16 flags = 0;
+    quint32 width = 0;
+    quint32 height = 0;
+    quint32 seams = 0;
+    quint16 op_length = 0;
+    if (in.readRawData(magic, sizeof(magic)) != sizeof(magic) ||
+        std::memcmp(magic, seam_map_magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    in >> version >> flags >> width >> height >> seams >> op_length;
+    const bool horizontal = flags & seam_map_horizontal;
+    const bool wide = flags & seam_map_wide;
+    if (in.status() != QDataStream::Ok || version != seam_map_version ||
+        width == 0 || height == 0 || width > seam_map_max_side || height > seam_map_max_side ||
+        seams >= (horizontal ? height : width)) {
+        return false;
+    }
+    QByteArray op(op_length, '\0');
+    if (in.readRawData(op.data(), op_length) != op_length) {
+        return false;
+    }
+    // 先由文件长度检查尺寸，截断或伪造的文件头不会导致按声明的尺寸分配内存
+    const qint64 entry = wide ? sizeof(quint32) : sizeof(quint16);
+    const qint64 line_bytes = (qint64) width * entry;
+    if (file.size() - file.pos() != line_bytes * height) {
+        return false;
+    }
+
+    SeamMap loaded;
+    loaded.horizontal = horizontal;
+    loaded.seams = seams;
+    loaded.op = QString::fromLatin1(op);
+    loaded.order.resize(width, height);
+    std::vector<quint16> narrow_line(width);
+    for (int y = 0; y < (int) height; y++) {
+        quint32 *o = loaded.order.row(y);
+        if (wide) {
+            if (in.readRawData(reinterpret_cast<char *>(o), (int) line_bytes) != line_bytes) {
+                return false;
+            }
+            qFromLittleEndian<quint32>(o, width, o);
+        } else {
+            if (in.readRawData(reinterpret_cast<char *>(narrow_line.data()), (int) line_bytes) != line_bytes) {
+                return false;
+            }
+            for (int x = 0; x < (int) width; x++) {
+                o[x] = qFromLittleEndian(narrow_line[x]);
+            }
+        }
+    }
+    if (!valid_order(loaded)) {
+        return false;
+    }
+    map = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef SEAM_MAP_H
+#define SEAM_MAP_H
+
+#include "seam_carver.h"
+#include "image_plane.h"
+
+#include <QImage>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+
+// 预先计算的 seam 移除顺序（Avidan & Shamir 论文中的 index map）
+// 一次性把图像缩到最小并记录每个像素被第几条 seam 移除，
+// 之后缩放到任意尺寸只需按顺序过滤一遍像素
+struct SeamMap {
+    bool horizontal = false;
+    // 记录的 seam 条数，即最多可以缩小的像素数
+    int seams = 0;
+    // 与原图同尺寸，order(x, y) 为该像素被移除的序号，未被移除的像素为 seams
+    Plane<quint32> order;
+    // 生成时使用的能量算子（find_kernels 的名称或 Forward），由调用者填写并随文件保存，不同算子的移除顺序不能混用
+    QString op;
+
+    bool isNull() const { return order.empty(); }
+    int width() const { return order.width(); }
+    int height() const { return order.height(); }
+    // 可以得到的最小宽度（竖直 seam）或高度（水平 seam）
+    int min_size() const { return (horizontal ? height() : width()) - seams; }
+};
+
+// 从 image 开始逐条移除 seam，记录移除顺序；max_seams < 0 时一直缩到只剩一列（行）
+// progress(done, total) 在每条 seam 之后调用，可以为空
+// cancel 不为空时在每条 seam 之前检查，被置位后返回空的 SeamMap
+SeamMap build_seam_map(
+    const QImage &image,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    bool horizontal, int max_seams = -1,
+    const std::function<void(int, int)> &progress = {},
+    const std::atomic<bool> *cancel = nullptr
+);
+
+// 由 CarveSession::removal_order() 记录的前 seams 条 seam 生成移除顺序
+SeamMap seam_map_from_order(const Plane<quint32> &order, int seams, bool horizontal);
+
+// 把 image 缩放到 size（竖直 seam 为宽度，水平 seam 为高度），size 会被限制在 [map.min_size(), 原尺寸] 内
+// map 须满足 load_seam_map 的检查：每行（水平 seam 时每列）中 0 ~ seams - 1 各出现一次，其余为 seams
+QImage retarget_with_seam_map(const QImage &image, const SeamMap &map, int size);
+
+// 二进制 sidecar 文件，小端序：
+// "SCMP" | u16 版本 | u16 标志（bit0 水平，bit1 序号为 32 位）| u32 宽 | u32 高 | u32 seam 条数 |
+// u16 算子名称长度 | 算子名称（Latin-1）| 按行存放的序号
+// seam 条数小于 65535 时序号以 16 位存放
+// 读取时检查尺寸与文件长度一致，并且每行（列）的序号恰好是 0 ~ seams - 1 各一次，否则返回 false
+bool save_seam_map(const SeamMap &map, const QString &path);
+bool load_seam_map(SeamMap &map, const QString &path);
+
+#endif // SEAM_MAP_H
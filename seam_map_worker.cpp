@@ -0,0 +1,28 @@
+#include "seam_map_worker.h"
+
+// 每隔多少条 seam 报告一次进度
+static const int seam_map_progress_step = 16;
+
+SeamMapWorker::SeamMapWorker(
+    const QImage &image,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    bool horizontal,
+    QObject *parent
+) : QThread(parent), image(image), kernelX(kernelX), kernelY(kernelY), window(window), horizontal(horizontal) {
+    // SeamMap 经队列连接传回界面线程
+    qRegisterMetaType<SeamMap>("SeamMap");
+}
+
+void SeamMapWorker::cancel() {
+    cancelled = true;
+}
+
+void SeamMapWorker::run() {
+    const SeamMap map = build_seam_map(image, kernelX, kernelY, window, horizontal, -1, [this](int done, int total) {
+        if (done % seam_map_progress_step == 0 || done == total) {
+            emit progress(done, total);
+        }
+    }, &cancelled);
+    // 只有被取消时 build_seam_map 才返回空的 SeamMap
+    emit built(map, map.isNull());
+}
@@ -0,0 +1,50 @@
+#ifndef SEAM_MAP_WORKER_H
+#define SEAM_MAP_WORKER_H
+
+#include "seam_carver.h"
+#include "seam_map.h"
+
+#include <QImage>
+#include <QMetaType>
+#include <QThread>
+
+#include <atomic>
+
+// 在后台线程中计算预览用的 seam 移除顺序（一次性缩到最小），可以随时取消
+// 界面线程只接收信号，计算期间不需要处理事件循环
+class SeamMapWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    // kernelX 与 kernelY 为空时使用前向能量，window 为 find_kernels 给出的窗口能量
+    SeamMapWorker(
+        const QImage &image,
+        const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+        bool horizontal,
+        QObject *parent = nullptr
+    );
+
+    // 在下一条 seam 之前停止，结果为空
+    void cancel();
+
+signals:
+    void progress(int done, int total);
+    // 被取消时 map 为空
+    void built(const SeamMap &map, bool cancelled);
+
+protected:
+    void run() override;
+
+private:
+    QImage image;
+    const Kernel *kernelX;
+    const Kernel *kernelY;
+    WindowEnergy window;
+    bool horizontal;
+    std::atomic<bool> cancelled{false};
+};
+
+Q_DECLARE_METATYPE(SeamMap)
+
+#endif // SEAM_MAP_WORKER_H
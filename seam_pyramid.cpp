@@ -0,0 +1,152 @@
+#include "seam_pyramid.h"
+#include "seam_carver.h"
+
+// 每层的宽高都不小于该值，否则不再下采样
+static const int min_level_size = 16;
+
+static std::vector<int> full_seam(const Plane<int> &energy, bool horizontal) {
+    return find_seam(energy, horizontal);
+}
+
+static std::vector<int> full_seam(const Plane<uchar> &gray, bool horizontal) {
+    return find_seam_forward(gray, horizontal);
+}
+
+static std::vector<int> banded_seam(
+    const Plane<int> &energy, const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal
+) {
+    return find_seam_banded(energy, lo, hi, horizontal);
+}
+
+static std::vector<int> banded_seam(
+    const Plane<uchar> &gray, const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal
+) {
+    return find_seam_forward_banded(gray, lo, hi, horizontal);
+}
+
+// 下一层 (x, y) 处的值为上一层 2x2 块的平均，越界时取边缘
+template <typename T>
+static T cell(const Plane<T> &src, int x, int y) {
+    const int x0 = qMin(2 * x, src.width() - 1);
+    const int x1 = qMin(2 * x + 1, src.width() - 1);
+    const int y0 = qMin(2 * y, src.height() - 1);
+    const int y1 = qMin(2 * y + 1, src.height() - 1);
+    return (T) ((src.at(x0, y0) + src.at(x1, y0) + src.at(x0, y1) + src.at(x1, y1) + 2) / 4);
+}
+
+template <typename T>
+SeamPyramid<T>::SeamPyramid(int levels, int band) : depth(qMax(0, levels)), margin(qMax(0, band)) {}
+
+template <typename T>
+int SeamPyramid<T>::levels() const {
+    return depth;
+}
+
+template <typename T>
+int SeamPyramid<T>::band() const {
+    return margin;
+}
+
+// 投影路径在原图上最多偏离 stale 个像素，不超过 band 时细化仍能覆盖真正的 seam
+template <typename T>
+bool SeamPyramid<T>::expired() const {
+    return stale > margin || stale >= (1 << depth);
+}
+
+template <typename T>
+void SeamPyramid<T>::rebuild(const Plane<T> &plane) {
+    pyramid.clear();
+    pyramid.reserve(depth);
+    const Plane<T> *src = &plane;
+    for (int l = 0; l < depth; l++) {
+        if (src->width() < 2 * min_level_size || src->height() < 2 * min_level_size) {
+            break;
+        }
+        Plane<T> dst((src->width() + 1) / 2, (src->height() + 1) / 2);
+        for (int y = 0; y < dst.height(); y++) {
+            T *line = dst.row(y);
+            for (int x = 0; x < dst.width(); x++) {
+                line[x] = cell(*src, x, y);
+            }
+        }
+        pyramid.push_back(std::move(dst));
+        src = &pyramid.back();
+    }
+    stale = 0;
+}
+
+template <typename T>
+std::vector<int> SeamPyramid<T>::find_seam(const Plane<T> &plane, bool horizontal) {
+    if (depth == 0) {
+        return full_seam(plane, horizontal);
+    }
+    if (pyramid.empty() || expired()) {
+        rebuild(plane);
+    }
+    if (pyramid.empty()) {
+        return full_seam(plane, horizontal);
+    }
+
+    // 在最上层做完整的动态规划，然后逐层细化
+    std::vector<int> seam = full_seam(pyramid.back(), horizontal);
+    for (int l = (int) pyramid.size() - 1; l >= 0; l--) {
+        const Plane<T> &level = l == 0 ? plane : pyramid[l - 1];
+        const int lines = horizontal ? level.width() : level.height();
+        const int n = horizontal ? level.height() : level.width();
+        const int coarse_lines = seam.size();
+        std::vector<int> lo(lines);
+        std::vector<int> hi(lines);
+        for (int i = 0; i < lines; i++) {
+            // 同时覆盖本线与上一条线对应的粗略位置，使相邻两条线的范围一定相交
+            const int c = seam[qMin(i / 2, coarse_lines - 1)];
+            const int p = seam[qMin(qMax(i - 1, 0) / 2, coarse_lines - 1)];
+            hi[i] = qMin(n - 1, qMax(c, p) * 2 + 1 + margin);
+            lo[i] = qMin(hi[i], qMax(0, qMin(c, p) * 2 - margin));
+        }
+        seam = banded_seam(level, lo, hi, horizontal);
+    }
+    return seam;
+}
+
+template <typename T>
+void SeamPyramid<T>::seam_removed(const Plane<T> &plane, const std::vector<int> &seam, bool horizontal) {
+    if (depth == 0 || pyramid.empty()) {
+        return;
+    }
+    stale++;
+    if (expired()) {
+        return;
+    }
+
+    // 逐层重新计算 seam 经过的格子及其左右各一格
+    std::vector<int> positions = seam;
+    for (int l = 0; l < (int) pyramid.size(); l++) {
+        const Plane<T> &src = l == 0 ? plane : pyramid[l - 1];
+        Plane<T> &dst = pyramid[l];
+        const int lines = horizontal ? dst.width() : dst.height();
+        const int n = horizontal ? dst.height() : dst.width();
+        const int last = (int) positions.size() - 1;
+        std::vector<int> next(lines);
+        for (int i = 0; i < lines; i++) {
+            const int a = qMin(positions[qMin(2 * i, last)], positions[qMin(2 * i + 1, last)]) / 2;
+            const int b = qMax(positions[qMin(2 * i, last)], positions[qMin(2 * i + 1, last)]) / 2;
+            for (int j = qMax(0, a - 1); j <= qMin(n - 1, b + 1); j++) {
+                if (horizontal) {
+                    dst.at(i, j) = cell(src, i, j);
+                } else {
+                    dst.at(j, i) = cell(src, j, i);
+                }
+            }
+            next[i] = a;
+        }
+        positions = std::move(next);
+    }
+}
+
+template <typename T>
+void SeamPyramid<T>::invalidate() {
+    pyramid.clear();
+}
+
+template class SeamPyramid<int>;
+template class SeamPyramid<uchar>;
@@ -0,0 +1,41 @@
+#ifndef SEAM_PYRAMID_H
+#define SEAM_PYRAMID_H
+
+#include "image_plane.h"
+
+#include <vector>
+
+// 多分辨率的 seam 搜索
+// 在逐层减半的下采样图上做完整的动态规划，再逐层投影到上一级，只在投影路径两侧的窄带内细化，直到原分辨率
+// T 为 int 时在能量图上搜索，为 uchar 时在灰度图上使用前向能量
+// 每移除一条 seam 只刷新各层中 seam 经过的格子；seam 右侧（下方）的格子没有随原图平移，
+// 与原图最多错开已移除条数个像素，错开超过细化的 band（并且至多 2^levels 条 seam）之前整体重建
+template <typename T>
+class SeamPyramid
+{
+public:
+    // levels 为下采样层数，0 表示不使用；band 为每层细化时投影路径两侧额外搜索的像素数
+    SeamPyramid(int levels = 0, int band = 4);
+
+    int levels() const;
+    int band() const;
+
+    std::vector<int> find_seam(const Plane<T> &plane, bool horizontal);
+    // plane 已移除 seam（并更新能量）之后调用
+    void seam_removed(const Plane<T> &plane, const std::vector<int> &seam, bool horizontal);
+    // plane 被其他方式修改后调用，下次搜索时重建
+    void invalidate();
+
+private:
+    int depth;
+    int margin;
+    // pyramid[l] 为第 l + 1 层
+    std::vector<Plane<T>> pyramid;
+    // 上次重建后移除的 seam 条数
+    int stale = 0;
+
+    bool expired() const;
+    void rebuild(const Plane<T> &plane);
+};
+
+#endif // SEAM_PYRAMID_H
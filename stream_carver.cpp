@@ -0,0 +1,391 @@
+#include "stream_carver.h"
+#include "image_plane.h"
+#include "window_energy.h"
+#include "trace.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include <climits>
+#include <cstring>
+#include <vector>
+
+// 每像素的前驱在 spill 文件中的编码
+static const int from_top = 0;
+static const int from_left = 1;
+static const int from_right = 2;
+
+static bool fail(QString *error, const QString &message) {
+    if (error != nullptr) {
+        *error = message;
+    }
+    return false;
+}
+
+bool read_ppm_header(const QString &path, int &width, int &height, qint64 *offset) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray head = file.read(1024);
+    // 依次读出 P6、宽、高、最大值，之间可以有空白与 # 注释
+    int pos = 0;
+    auto skip = [&]() {
+        while (pos < head.size()) {
+            if (head[pos] == '#') {
+                while (pos < head.size() && head[pos] != '\n') {
+                    pos++;
+                }
+            } else if (head[pos] == ' ' || head[pos] == '\t' || head[pos] == '\r' || head[pos] == '\n') {
+                pos++;
+            } else {
+                break;
+            }
+        }
+    };
+    auto number = [&]() {
+        skip();
+        long long value = 0;
+        const int begin = pos;
+        while (pos < head.size() && head[pos] >= '0' && head[pos] <= '9' && value <= INT_MAX) {
+            value = value * 10 + (head[pos] - '0');
+            pos++;
+        }
+        return pos == begin || value > INT_MAX ? -1 : (int) value;
+    };
+    if (head.size() < 2 || head[0] != 'P' || head[1] != '6') {
+        return false;
+    }
+    pos = 2;
+    width = number();
+    height = number();
+    const int max_value = number();
+    // 最大值之后恰好一个空白字符
+    if (width <= 0 || height <= 0 || max_value != 255 || pos >= head.size()) {
+        return false;
+    }
+    const qint64 data = pos + 1;
+    if (file.size() < data + (qint64) width * height * 3) {
+        return false;
+    }
+    if (offset != nullptr) {
+        *offset = data;
+    }
+    return true;
+}
+
+// 文件中按行存放的数据的映射窗口，一次至多映射 rows 行
+// 向后访问时窗口从请求的行开始，向前访问时窗口在请求的行结束，顺序扫描时每行只映射一次
+class RowWindow
+{
+public:
+    RowWindow(QFile &file, qint64 offset, qint64 row_bytes, int height, int rows)
+        : file(file), offset(offset), row_bytes(row_bytes), height(height), rows(qMax(1, qMin(rows, height))) {}
+    ~RowWindow() { unmap(); }
+
+    RowWindow(const RowWindow &) = delete;
+    RowWindow &operator=(const RowWindow &) = delete;
+
+    // 映射失败时返回空指针
+    uchar *row(int y) {
+        if (base == nullptr || y < y0 || y >= y1) {
+            unmap();
+            y0 = y >= y1 ? y : qMax(0, y - rows + 1);
+            y1 = qMin(height, y0 + rows);
+            base = file.map(offset + y0 * row_bytes, (y1 - y0) * row_bytes);
+            if (base == nullptr) {
+                return nullptr;
+            }
+        }
+        return base + (y - y0) * row_bytes;
+    }
+
+private:
+    QFile &file;
+    qint64 offset;
+    qint64 row_bytes;
+    int height;
+    int rows;
+    int y0 = 0;
+    int y1 = 0;
+    uchar *base = nullptr;
+
+    void unmap() {
+        if (base != nullptr) {
+            file.unmap(base);
+            base = nullptr;
+        }
+    }
+};
+
+// 一次流式 carve 的状态
+// 工作文件的行距固定为原图宽度，每移除一条 seam 逻辑宽度减一；行内缓冲区按原图宽度分配，之后不再分配
+class StreamCarver
+{
+public:
+    StreamCarver(int width, int height, const Kernel *kernelX, const Kernel *kernelY)
+        : width(width), height(height), row_bytes((qint64) width * 3),
+          kernelX(kernelX), kernelY(kernelY),
+          lines(width, 3), energy(width, 3), cost(width), prev_cost(width), seam(height) {}
+
+    // 除映射窗口外常驻的内存
+    static qint64 fixed_bytes(int width, int height) {
+        return (qint64) width * (3 + 3 * sizeof(int) + 2 * sizeof(long long)) + (qint64) height * sizeof(int) + 4096;
+    }
+
+    // 扫描一遍图像：先从 source（为空时是工作文件本身）取得第 y 行，移除上一条 seam 后写回工作文件，
+    // 再计算灰度并递推下一条 seam；output 不为空时同时写出该行，不再递推
+    bool pass(RowWindow &work, RowWindow *source, RowWindow &spill, QFile *output, bool remove);
+
+    // 沿 spill 文件中的前驱回溯出 seam，返回它的能量
+    bool trace(RowWindow &spill, long long &seam_cost);
+
+private:
+    int width;
+    int height;
+    qint64 row_bytes;
+    const Kernel *kernelX;
+    const Kernel *kernelY;
+    int w = 0;
+    // 上一行、当前行、下一行的灰度与当前行的能量，第 1 行对应当前行
+    Plane<uchar> lines;
+    Plane<int> energy;
+    // DP 只保留两行累积能量
+    std::vector<long long> cost;
+    std::vector<long long> prev_cost;
+    std::vector<int> seam;
+
+    bool forward() const { return kernelX == nullptr || kernelY == nullptr; }
+    void gray_row(const uchar *rgb, uchar *g) const;
+    bool dp_row(int y, RowWindow &spill);
+};
+
+void StreamCarver::gray_row(const uchar *rgb, uchar *g) const {
+    for (int x = 0; x < w; x++) {
+        g[x] = qGray(rgb[3 * x], rgb[3 * x + 1], rgb[3 * x + 2]);
+    }
+}
+
+// 递推第 y 行，lines 中为第 y - 1 ~ y + 1 行的灰度（越界时取边界行）
+bool StreamCarver::dp_row(int y, RowWindow &spill) {
+    const uchar *g = lines.row(1);
+    const uchar *g_prev = lines.row(0);
+    const int *e = energy.row(1);
+    if (!forward()) {
+        calc_energy_conv_span(lines, energy, 1, 0, w - 1, *kernelX, *kernelY);
+    }
+    if (y == 0) {
+        for (int j = 0; j < w; j++) {
+            cost[j] = forward() ? qAbs(g[qMax(0, j - 1)] - g[qMin(w - 1, j + 1)]) : e[j];
+        }
+        return true;
+    }
+
+    uchar *codes = spill.row(y);
+    if (codes == nullptr) {
+        return false;
+    }
+    std::swap(cost, prev_cost);
+    const long long *prev = prev_cost.data();
+    uchar packed = 0;
+    for (int j = 0; j < w; j++) {
+        long long sum_top = prev[j];
+        long long sum_left_top = j == 0 ? LLONG_MAX : prev[j - 1];
+        long long sum_right_top = j == w - 1 ? LLONG_MAX : prev[j + 1];
+        long long pixel = 0;
+        if (forward()) {
+            // 与 seam_dp_forward 相同的转移代价
+            const int left = g[qMax(0, j - 1)];
+            const int right = g[qMin(w - 1, j + 1)];
+            const int top = g_prev[j];
+            const int cT = qAbs(left - right);
+            sum_top += cT;
+            if (j > 0) {
+                sum_left_top += cT + qAbs(top - left);
+            }
+            if (j < w - 1) {
+                sum_right_top += cT + qAbs(top - right);
+            }
+        } else {
+            pixel = e[j];
+        }
+
+        // 相同时依次优先上、左上、右上，与 seam_dp 一致
+        long long sum_min = sum_top;
+        int from = from_top;
+        if (sum_left_top < sum_min) {
+            sum_min = sum_left_top;
+            from = from_left;
+        }
+        if (sum_right_top < sum_min) {
+            sum_min = sum_right_top;
+            from = from_right;
+        }
+        cost[j] = sum_min + pixel;
+
+        packed |= from << ((j & 3) * 2);
+        if ((j & 3) == 3 || j == w - 1) {
+            codes[j >> 2] = packed;
+            packed = 0;
+        }
+    }
+    return true;
+}
+
+bool StreamCarver::pass(RowWindow &work, RowWindow *source, RowWindow &spill, QFile *output, bool remove) {
+    SEAM_CARVER_TRACE_PIXELS("stream_pass", (long long) w * height);
+    if (source != nullptr) {
+        w = width;
+    }
+    const int col = w;
+    if (remove) {
+        w--;
+    }
+    lines.truncate(w, 3);
+    energy.truncate(w, 3);
+
+    for (int y = 0; y < height; y++) {
+        uchar *line = work.row(y);
+        if (line == nullptr) {
+            return false;
+        }
+        if (source != nullptr) {
+            const uchar *src = source->row(y);
+            if (src == nullptr) {
+                return false;
+            }
+            std::memcpy(line, src, row_bytes);
+        }
+        if (remove) {
+            const int x = seam[y];
+            std::memmove(line + x * 3, line + (x + 1) * 3, (col - x - 1) * 3);
+        }
+        if (output != nullptr) {
+            if (output->write(reinterpret_cast<const char *>(line), (qint64) w * 3) != (qint64) w * 3) {
+                return false;
+            }
+            continue;
+        }
+
+        // 第 y 行的灰度到达后才能递推第 y - 1 行
+        if (y == 0) {
+            gray_row(line, lines.row(1));
+            std::memcpy(lines.row(0), lines.row(1), w);
+            continue;
+        }
+        gray_row(line, lines.row(2));
+        if (!dp_row(y - 1, spill)) {
+            return false;
+        }
+        std::memcpy(lines.row(0), lines.row(1), w);
+        std::memcpy(lines.row(1), lines.row(2), w);
+    }
+    if (output != nullptr) {
+        return true;
+    }
+    std::memcpy(lines.row(2), lines.row(1), w);
+    return dp_row(height - 1, spill);
+}
+
+bool StreamCarver::trace(RowWindow &spill, long long &seam_cost) {
+    int x = 0;
+    for (int j = 1; j < w; j++) {
+        if (cost[j] < cost[x]) {
+            x = j;
+        }
+    }
+    seam_cost = cost[x];
+    seam[height - 1] = x;
+    for (int y = height - 1; y > 0; y--) {
+        const uchar *codes = spill.row(y);
+        if (codes == nullptr) {
+            return false;
+        }
+        const int from = (codes[x >> 2] >> ((x & 3) * 2)) & 3;
+        x += from == from_left ? -1 : (from == from_right ? 1 : 0);
+        seam[y - 1] = x;
+    }
+    return true;
+}
+
+bool stream_carve(
+    const QString &input, const QString &output, int target_width,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    const StreamOptions &options, long long *removed, QString *error
+) {
+    SEAM_CARVER_TRACE_SCOPE("stream_carve");
+    int width = 0;
+    int height = 0;
+    qint64 offset = 0;
+    if (!read_ppm_header(input, width, height, &offset)) {
+        return fail(error, "not a binary 8-bit PPM: " + input);
+    }
+    if (target_width < 1 || target_width > width) {
+        return fail(error, "streaming mode can only reduce the width");
+    }
+    // 行窗口只保留相邻三行，放不下 HoG 与 Entropy 的统计窗口
+    if (window != WindowEnergy::None) {
+        return fail(error, "streaming mode does not support the HoG and Entropy operators");
+    }
+
+    // 预算扣除常驻部分后，输入、工作文件与 spill 文件的窗口各占三分之一
+    const qint64 row_bytes = (qint64) width * 3;
+    const qint64 spill_bytes = (width + 3) / 4;
+    const qint64 window_budget = (options.memory_budget - StreamCarver::fixed_bytes(width, height)) / 3;
+    if (window_budget < row_bytes) {
+        return fail(error, QString("memory budget too small for a %1 pixel wide image").arg(width));
+    }
+    const int image_rows = (int) qMin<qint64>(height, window_budget / row_bytes);
+    const int spill_rows = (int) qMin<qint64>(height, window_budget / spill_bytes);
+
+    QFile source_file(input);
+    if (!source_file.open(QIODevice::ReadOnly)) {
+        return fail(error, "cannot read " + input);
+    }
+    const QString temp_dir = options.temp_dir.isEmpty() ? QFileInfo(output).absolutePath() : options.temp_dir;
+    QTemporaryFile work_file(QDir(temp_dir).filePath("seam-carving-work-XXXXXX"));
+    QTemporaryFile spill_file(QDir(temp_dir).filePath("seam-carving-spill-XXXXXX"));
+    if (!work_file.open() || !work_file.resize(row_bytes * height) ||
+        !spill_file.open() || !spill_file.resize(spill_bytes * height)) {
+        return fail(error, "cannot create temporary files in " + temp_dir);
+    }
+    QFile output_file(output);
+    if (!output_file.open(QIODevice::WriteOnly)) {
+        return fail(error, "cannot write " + output);
+    }
+    const QByteArray header = QString("P6\n%1 %2\n255\n").arg(target_width).arg(height).toLatin1();
+    if (output_file.write(header) != header.size()) {
+        return fail(error, "cannot write " + output);
+    }
+
+    StreamCarver carver(width, height, kernelX, kernelY);
+    const int seams = width - target_width;
+    bool ok = true;
+    {
+        RowWindow source(source_file, offset, row_bytes, height, image_rows);
+        RowWindow work(work_file, 0, row_bytes, height, image_rows);
+        RowWindow spill(spill_file, 0, spill_bytes, height, spill_rows);
+        ok = carver.pass(work, &source, spill, seams == 0 ? &output_file : nullptr, false);
+    }
+    for (int i = 0; ok && i < seams; i++) {
+        long long seam_cost = 0;
+        {
+            RowWindow spill(spill_file, 0, spill_bytes, height, spill_rows);
+            ok = carver.trace(spill, seam_cost);
+        }
+        if (removed != nullptr) {
+            *removed += seam_cost;
+        }
+        // 最后一条 seam 移除的同时写出结果，窗口在每遍之后解除映射
+        RowWindow work(work_file, 0, row_bytes, height, image_rows);
+        RowWindow spill(spill_file, 0, spill_bytes, height, spill_rows);
+        ok = ok && carver.pass(work, nullptr, spill, i == seams - 1 ? &output_file : nullptr, true);
+    }
+    if (!ok || !output_file.flush()) {
+        output_file.remove();
+        return fail(error, "I/O error while carving " + input);
+    }
+    return true;
+}
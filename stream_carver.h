@@ -0,0 +1,32 @@
+#ifndef STREAM_CARVER_H
+#define STREAM_CARVER_H
+
+#include "seam_carver.h"
+
+#include <QString>
+
+// 放不进内存的大图的流式 carve，只缩小宽度（竖直 seam）
+// 输入输出为二进制 PPM（P6，每通道 8 位）。图像不整体解码，而是复制到工作文件中按行窗口内存映射访问：
+// 每条 seam 顺序扫描一遍图像，同时原地移除上一条 seam、计算灰度与能量并递推，
+// DP 只保留两行累积能量，回溯用的前驱以每像素 2 位写入 spill 文件，最后逐行写出结果。
+// 结果与 CarveSession 逐条移除相同
+struct StreamOptions {
+    // 内存预算（字节），映射窗口与各行缓冲区的总和不超过它
+    qint64 memory_budget = 256LL << 20;
+    // 工作文件与 spill 文件所在的目录，为空时使用输出文件所在的目录
+    QString temp_dir;
+};
+
+// 读取 PPM 文件头，offset 为像素数据在文件中的起始位置；格式不支持时返回 false
+bool read_ppm_header(const QString &path, int &width, int &height, qint64 *offset = nullptr);
+
+// 把 input 的宽度缩小到 target_width 并写入 output；kernelX 与 kernelY 为空时使用前向能量，不支持窗口能量
+// removed 不为空时累加被移除 seam 的能量；失败时返回 false，原因写入 error
+bool stream_carve(
+    const QString &input, const QString &output, int target_width,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    const StreamOptions &options = StreamOptions(),
+    long long *removed = nullptr, QString *error = nullptr
+);
+
+#endif // STREAM_CARVER_H
@@ -0,0 +1,131 @@
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> trace_on{false};
+
+struct TraceEvent {
+    const char *name;
+    // 'X' 为区间，'C' 为计数器
+    char phase;
+    int tid;
+    long long ts;
+    long long dur;
+    long long pixels;
+    long long bytes;
+};
+
+static std::mutex trace_mutex;
+static std::string trace_path;
+static std::vector<TraceEvent> trace_events;
+static std::chrono::steady_clock::time_point trace_origin;
+static std::atomic<long long> allocated_bytes{0};
+static std::atomic<long long> touched_pixels{0};
+static std::atomic<int> next_tid{1};
+
+static thread_local int thread_id = 0;
+static thread_local int scope_depth = 0;
+
+static long long now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - trace_origin).count();
+}
+
+static int current_tid() {
+    if (thread_id == 0) {
+        thread_id = next_tid++;
+    }
+    return thread_id;
+}
+
+// 由环境变量开启时，在进程退出时写出
+struct TraceFromEnvironment {
+    TraceFromEnvironment() {
+        const char *path = std::getenv("SEAM_CARVER_TRACE");
+        if (path != nullptr && path[0] != '\0') {
+            trace_start(path);
+        }
+    }
+    ~TraceFromEnvironment() {
+        trace_stop();
+    }
+};
+
+static TraceFromEnvironment trace_from_environment;
+
+bool trace_start(const std::string &path) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_on) {
+        return false;
+    }
+    trace_path = path;
+    trace_events.clear();
+    trace_origin = std::chrono::steady_clock::now();
+    allocated_bytes = 0;
+    touched_pixels = 0;
+    trace_on = true;
+    return true;
+}
+
+bool trace_stop() {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!trace_on) {
+        return true;
+    }
+    trace_on = false;
+
+    FILE *file = std::fopen(trace_path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (std::size_t i = 0; i < trace_events.size(); i++) {
+        const TraceEvent &e = trace_events[i];
+        const char *separator = i + 1 < trace_events.size() ? "," : "";
+        if (e.phase == 'X') {
+            std::fprintf(file, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %lld, \"dur\": %lld, "
+                               "\"args\": {\"pixels\": %lld}}%s\n",
+                         e.name, e.tid, e.ts, e.dur, e.pixels, separator);
+        } else {
+            std::fprintf(file, "{\"name\": \"%s\", \"ph\": \"C\", \"pid\": 1, \"tid\": %d, \"ts\": %lld, "
+                               "\"args\": {\"bytes allocated\": %lld, \"pixels touched\": %lld}}%s\n",
+                         e.name, e.tid, e.ts, e.bytes, e.pixels, separator);
+        }
+    }
+    std::fprintf(file, "]}\n");
+    trace_events.clear();
+    return std::fclose(file) == 0;
+}
+
+void trace_allocated(std::size_t bytes) {
+    allocated_bytes += bytes;
+}
+
+TraceScope::TraceScope(const char *name, long long pixels) : name(name), pixels(pixels) {
+    if (trace_enabled()) {
+        scope_depth++;
+        begin = now_us();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (begin < 0) {
+        return;
+    }
+    const long long end = now_us();
+    const bool outermost = --scope_depth == 0;
+    const long long pixel_total = touched_pixels += pixels;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!trace_on) {
+        return;
+    }
+    const int tid = current_tid();
+    trace_events.push_back({name, 'X', tid, begin, end - begin, pixels, 0});
+    if (outermost) {
+        trace_events.push_back({"counters", 'C', tid, end, 0, pixel_total, allocated_bytes.load()});
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// 热点路径的计时，输出 Chrome / Perfetto 可以打开的 trace JSON
+// 运行时由环境变量 SEAM_CARVER_TRACE=<文件> 或 trace_start() 开启；
+// 编译时未定义 SEAM_CARVER_TRACING 则下面的宏全部展开为空
+
+// 开始记录，trace_stop() 时写入 path；已在记录时返回 false
+bool trace_start(const std::string &path);
+// 停止记录并写出文件，写入失败时返回 false
+bool trace_stop();
+
+extern std::atomic<bool> trace_on;
+
+inline bool trace_enabled() {
+    return trace_on.load(std::memory_order_relaxed);
+}
+
+// 累计分配的字节数
+void trace_allocated(std::size_t bytes);
+
+// 记录一段区间（Chrome trace 的 complete event），pixels 为本区间处理的像素数
+// 每个线程最外层的区间结束时同时记录累计的分配字节数与处理像素数
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name, long long pixels = 0);
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name;
+    long long pixels;
+    long long begin = -1;
+};
+
+#ifdef SEAM_CARVER_TRACING
+#define SEAM_CARVER_TRACE_JOIN2(a, b) a##b
+#define SEAM_CARVER_TRACE_JOIN(a, b) SEAM_CARVER_TRACE_JOIN2(a, b)
+#define SEAM_CARVER_TRACE_SCOPE(name) TraceScope SEAM_CARVER_TRACE_JOIN(trace_scope_, __LINE__)(name)
+#define SEAM_CARVER_TRACE_PIXELS(name, pixels) TraceScope SEAM_CARVER_TRACE_JOIN(trace_scope_, __LINE__)(name, pixels)
+#define SEAM_CARVER_TRACE_ALLOC(bytes) \
+    do { if (trace_enabled()) trace_allocated(bytes); } while (0)
+#else
+#define SEAM_CARVER_TRACE_SCOPE(name)
+#define SEAM_CARVER_TRACE_PIXELS(name, pixels)
+#define SEAM_CARVER_TRACE_ALLOC(bytes) do {} while (0)
+#endif
+
+#endif // TRACE_H
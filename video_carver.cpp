@@ -0,0 +1,412 @@
+#include "video_carver.h"
+#include "carve_session.h"
+#include "trace.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+VideoCarver::VideoCarver(
+    int width, int height, int target_width, int target_height,
+    const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+    int band, int keyframe_interval
+) : width(width), height(height),
+    target_width(qBound(1, target_width, width)), target_height(qBound(1, target_height, height)),
+    kernelX(kernelX), kernelY(kernelY), window(window), band(qMax(0, band)), keyframe_interval(qMax(0, keyframe_interval)) {
+    // 窗口能量与 seam 的方向无关，只有卷积核需要按方向转置
+    if (!forward() && window == WindowEnergy::None) {
+        horizontal_kernels(*kernelX, *kernelY, transposedX, transposedY, horizontalX, horizontalY);
+    } else {
+        horizontalX = kernelX;
+        horizontalY = kernelY;
+    }
+}
+
+long long VideoCarver::carve(VideoFrame &frame) {
+    SEAM_CARVER_TRACE_PIXELS("video_frame", (long long) width * height);
+    const bool keyframe = frame_index == 0 || (keyframe_interval > 0 && frame_index % keyframe_interval == 0);
+    frame_index++;
+    long long removed = carve_direction(frame, width - target_width, false, keyframe);
+    removed += carve_direction(frame, height - target_height, true, keyframe);
+    return removed;
+}
+
+long long VideoCarver::carve_direction(VideoFrame &frame, int count, bool horizontal, bool keyframe) {
+    if (count <= 0) {
+        return 0;
+    }
+    Plane<uchar> &luma = frame.planes[0];
+    const Kernel *kx = horizontal ? horizontalX : kernelX;
+    const Kernel *ky = horizontal ? horizontalY : kernelY;
+    if (!forward()) {
+        calc_energy_conv(luma, energy, *kx, *ky, window);
+    }
+
+    std::vector<std::vector<int>> &previous = seams[horizontal];
+    previous.resize(count);
+    std::vector<int> lo;
+    std::vector<int> hi;
+    long long removed = 0;
+    for (int i = 0; i < count; i++) {
+        std::vector<int> &seam = previous[i];
+        const int lines = horizontal ? luma.width() : luma.height();
+        const int n = horizontal ? luma.height() : luma.width();
+        if (keyframe || (int) seam.size() != lines) {
+            if (forward()) {
+                find_seam_forward(luma, scratch, seam, horizontal);
+            } else {
+                find_seam(energy, scratch, seam, horizontal);
+            }
+        } else {
+            // 上一帧同一序号的 seam 两侧各 band 个像素，相邻两线的范围必然相交
+            lo.resize(lines);
+            hi.resize(lines);
+            for (int l = 0; l < lines; l++) {
+                lo[l] = qMax(0, seam[l] - band);
+                hi[l] = qMin(n - 1, seam[l] + band);
+            }
+            seam = forward() ? find_seam_forward_banded(luma, lo, hi, horizontal)
+                             : find_seam_banded(energy, lo, hi, horizontal);
+        }
+
+        if (forward()) {
+            removed += forward_seam_cost(luma, seam, horizontal);
+        } else {
+            for (int l = 0; l < lines; l++) {
+                removed += horizontal ? energy.at(l, seam[l]) : energy.at(seam[l], l);
+            }
+        }
+        for (Plane<uchar> &plane : frame.planes) {
+            if (horizontal) {
+                remove_horizontal_seam(plane, seam);
+            } else {
+                remove_seam(plane, seam);
+            }
+        }
+        if (!forward()) {
+            if (horizontal) {
+                remove_horizontal_seam(energy, seam);
+            } else {
+                remove_seam(energy, seam);
+            }
+            update_energy_band(luma, energy, *kx, *ky, window, seam, 1, horizontal);
+        }
+    }
+    return removed;
+}
+
+// Y4M 的色度格式
+enum class Chroma { Mono, C420, C444 };
+
+struct Y4MFormat {
+    int width = 0;
+    int height = 0;
+    Chroma chroma = Chroma::C420;
+    // 除 W、H 外的其余参数，原样写回输出
+    QList<QByteArray> tags;
+};
+
+static int chroma_width(const Y4MFormat &format, int width) {
+    return format.chroma == Chroma::C420 ? (width + 1) / 2 : width;
+}
+
+static int chroma_height(const Y4MFormat &format, int height) {
+    return format.chroma == Chroma::C420 ? (height + 1) / 2 : height;
+}
+
+static bool read_header(QFile &input, Y4MFormat &format, QString *error) {
+    QByteArray line = input.readLine(4096);
+    if (line.endsWith('\n')) {
+        line.chop(1);
+    }
+    const QList<QByteArray> tokens = line.split(' ');
+    if (tokens.isEmpty() || tokens[0] != "YUV4MPEG2") {
+        *error = "input is not a YUV4MPEG2 stream";
+        return false;
+    }
+    for (int i = 1; i < tokens.size(); i++) {
+        const QByteArray &token = tokens[i];
+        if (token.startsWith('W')) {
+            format.width = token.mid(1).toInt();
+        } else if (token.startsWith('H')) {
+            format.height = token.mid(1).toInt();
+        } else {
+            if (token.startsWith('C')) {
+                if (token.startsWith("C420")) {
+                    format.chroma = Chroma::C420;
+                } else if (token == "C444") {
+                    format.chroma = Chroma::C444;
+                } else if (token == "Cmono") {
+                    format.chroma = Chroma::Mono;
+                } else {
+                    *error = "unsupported Y4M colour space " + QString::fromLatin1(token.mid(1));
+                    return false;
+                }
+            }
+            if (!token.isEmpty()) {
+                format.tags.append(token);
+            }
+        }
+    }
+    if (format.width <= 0 || format.height <= 0) {
+        *error = "Y4M header without a frame size";
+        return false;
+    }
+    return true;
+}
+
+static bool write_header(QFile &output, const Y4MFormat &format, int width, int height) {
+    QByteArray header = "YUV4MPEG2 W" + QByteArray::number(width) + " H" + QByteArray::number(height);
+    for (const QByteArray &tag : format.tags) {
+        header += ' ' + tag;
+    }
+    header += '\n';
+    return output.write(header) == header.size();
+}
+
+static bool read_fully(QFile &input, uchar *data, qint64 size) {
+    while (size > 0) {
+        const qint64 n = input.read(reinterpret_cast<char *>(data), size);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// 读入一帧，色度平面最近邻上采样到亮度的分辨率；输入结束时 end 为 true
+static bool read_frame(QFile &input, const Y4MFormat &format, VideoFrame &frame, std::vector<uchar> &line, bool &end) {
+    const QByteArray marker = input.readLine(4096);
+    end = marker.isEmpty();
+    if (end) {
+        return true;
+    }
+    if (!marker.startsWith("FRAME")) {
+        return false;
+    }
+    const int planes = format.chroma == Chroma::Mono ? 1 : 3;
+    frame.planes.resize(planes);
+    frame.planes[0].resize(format.width, format.height);
+    for (int y = 0; y < format.height; y++) {
+        if (!read_fully(input, frame.planes[0].row(y), format.width)) {
+            return false;
+        }
+    }
+    const int cw = chroma_width(format, format.width);
+    const int ch = chroma_height(format, format.height);
+    line.resize(cw);
+    for (int p = 1; p < planes; p++) {
+        Plane<uchar> &plane = frame.planes[p];
+        plane.resize(format.width, format.height);
+        for (int cy = 0; cy < ch; cy++) {
+            if (!read_fully(input, line.data(), cw)) {
+                return false;
+            }
+            const int y0 = format.chroma == Chroma::C420 ? 2 * cy : cy;
+            const int y1 = qMin(format.height, format.chroma == Chroma::C420 ? y0 + 2 : y0 + 1);
+            for (int y = y0; y < y1; y++) {
+                uchar *dst = plane.row(y);
+                for (int x = 0; x < format.width; x++) {
+                    dst[x] = line[format.chroma == Chroma::C420 ? x / 2 : x];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// 写出一帧，4:2:0 的色度平面按 2x2 块取平均下采样
+static bool write_frame(QFile &output, const Y4MFormat &format, const VideoFrame &frame, std::vector<uchar> &line) {
+    static const char marker[] = "FRAME\n";
+    if (output.write(marker, sizeof(marker) - 1) != (qint64) sizeof(marker) - 1) {
+        return false;
+    }
+    const Plane<uchar> &luma = frame.planes[0];
+    const int width = luma.width();
+    const int height = luma.height();
+    for (int y = 0; y < height; y++) {
+        if (output.write(reinterpret_cast<const char *>(luma.row(y)), width) != width) {
+            return false;
+        }
+    }
+    const int cw = chroma_width(format, width);
+    const int ch = chroma_height(format, height);
+    line.resize(cw);
+    for (int p = 1; p < (int) frame.planes.size(); p++) {
+        const Plane<uchar> &plane = frame.planes[p];
+        for (int cy = 0; cy < ch; cy++) {
+            if (format.chroma == Chroma::C420) {
+                const uchar *top = plane.row(2 * cy);
+                const uchar *bottom = plane.row(qMin(height - 1, 2 * cy + 1));
+                for (int cx = 0; cx < cw; cx++) {
+                    const int x0 = 2 * cx;
+                    const int x1 = qMin(width - 1, x0 + 1);
+                    line[cx] = (top[x0] + top[x1] + bottom[x0] + bottom[x1] + 2) / 4;
+                }
+            } else {
+                std::copy(plane.row(cy), plane.row(cy) + cw, line.begin());
+            }
+            if (output.write(reinterpret_cast<const char *>(line.data()), cw) != cw) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 线程之间传递帧的有界队列；任一端关闭后 push 失败，pop 取完剩余的帧后失败
+class FrameQueue
+{
+public:
+    explicit FrameQueue(int capacity) : capacity(qMax(1, capacity)) {}
+
+    bool push(VideoFrame &frame) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&] { return closed || (int) frames.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        frames.push_back(std::move(frame));
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool pop(VideoFrame &frame) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&] { return closed || !frames.empty(); });
+        if (frames.empty()) {
+            return false;
+        }
+        frame = std::move(frames.front());
+        frames.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<VideoFrame> frames;
+    int capacity;
+    bool closed = false;
+};
+
+bool carve_video(
+    QFile &input, QFile &output, const VideoOptions &options,
+    VideoStats *stats, QString *error
+) {
+    SEAM_CARVER_TRACE_SCOPE("carve_video");
+    QString message;
+    Y4MFormat format;
+    if (!read_header(input, format, &message)) {
+        if (error != nullptr) {
+            *error = message;
+        }
+        return false;
+    }
+    const int target_width = options.width > 0 ? qMin(options.width, format.width) : format.width;
+    const int target_height = options.height > 0 ? qMin(options.height, format.height) : format.height;
+    if (!write_header(output, format, target_width, target_height)) {
+        if (error != nullptr) {
+            *error = "cannot write the Y4M header";
+        }
+        return false;
+    }
+
+    VideoStats result;
+    result.width = target_width;
+    result.height = target_height;
+    FrameQueue decoded(options.queue_frames);
+    FrameQueue carved(options.queue_frames);
+    std::mutex error_mutex;
+    auto set_error = [&](const QString &text) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (message.isEmpty()) {
+            message = text;
+        }
+    };
+
+    std::thread decoder([&]() {
+        std::vector<uchar> line;
+        QElapsedTimer timer;
+        for (;;) {
+            VideoFrame frame;
+            bool end = false;
+            timer.start();
+            const bool ok = read_frame(input, format, frame, line, end);
+            result.decode_seconds += timer.nsecsElapsed() / 1e9;
+            if (!ok) {
+                set_error("truncated or malformed Y4M frame");
+            }
+            if (!ok || end || !decoded.push(frame)) {
+                break;
+            }
+        }
+        decoded.close();
+    });
+    std::thread encoder([&]() {
+        std::vector<uchar> line;
+        QElapsedTimer timer;
+        VideoFrame frame;
+        while (carved.pop(frame)) {
+            timer.start();
+            const bool ok = write_frame(output, format, frame, line);
+            result.encode_seconds += timer.nsecsElapsed() / 1e9;
+            if (!ok) {
+                set_error("cannot write the output stream");
+                break;
+            }
+        }
+        // 写出失败时让上游停下
+        carved.close();
+    });
+
+    VideoCarver carver(
+        format.width, format.height, target_width, target_height,
+        options.kernelX, options.kernelY, options.window, options.band, options.keyframe_interval
+    );
+    QElapsedTimer timer;
+    VideoFrame frame;
+    while (decoded.pop(frame)) {
+        timer.start();
+        result.removed_energy += carver.carve(frame);
+        result.carve_seconds += timer.nsecsElapsed() / 1e9;
+        result.frames++;
+        if (!carved.push(frame)) {
+            break;
+        }
+    }
+    decoded.close();
+    carved.close();
+    decoder.join();
+    encoder.join();
+
+    if (!output.flush()) {
+        set_error("cannot write the output stream");
+    }
+    if (stats != nullptr) {
+        *stats = result;
+    }
+    if (!message.isEmpty()) {
+        if (error != nullptr) {
+            *error = message;
+        }
+        return false;
+    }
+    return true;
+}
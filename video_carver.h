@@ -0,0 +1,91 @@
+#ifndef VIDEO_CARVER_H
+#define VIDEO_CARVER_H
+
+#include "seam_carver.h"
+#include "image_plane.h"
+
+#include <QFile>
+#include <QString>
+
+#include <vector>
+
+// 一帧 YUV 图像，色度平面已上采样到亮度的分辨率，mono 时只有亮度平面
+struct VideoFrame {
+    std::vector<Plane<uchar>> planes;
+};
+
+// 逐帧把同一尺寸的视频缩小到目标尺寸，先移除竖直 seam，再移除水平 seam
+// 能量只在亮度平面上计算。第一帧（以及关键帧）做完整的动态规划；之后每帧的第 i 条 seam
+// 只在上一帧第 i 条 seam 两侧 band 个像素内寻找，每条 seam 的代价与图像高（宽）成正比，
+// 相邻帧的 seam 也不会跳动
+class VideoCarver
+{
+public:
+    // kernelX 与 kernelY 为空时使用前向能量，window 为 find_kernels 给出的窗口能量；
+    // keyframe_interval 为 0 时只有第一帧是关键帧
+    VideoCarver(
+        int width, int height, int target_width, int target_height,
+        const Kernel *kernelX, const Kernel *kernelY, WindowEnergy window,
+        int band = 8, int keyframe_interval = 0
+    );
+
+    // 原地缩小 frame 的所有平面，返回本帧移除 seam 的能量之和
+    long long carve(VideoFrame &frame);
+
+private:
+    int width;
+    int height;
+    int target_width;
+    int target_height;
+    const Kernel *kernelX;
+    const Kernel *kernelY;
+    WindowEnergy window;
+    Kernel transposedX;
+    Kernel transposedY;
+    const Kernel *horizontalX = nullptr;
+    const Kernel *horizontalY = nullptr;
+    int band;
+    int keyframe_interval;
+    int frame_index = 0;
+    Plane<int> energy;
+    SeamScratch scratch;
+    // 上一帧两个方向上依次移除的 seam，坐标为移除时（已缩小的）图像中的坐标
+    std::vector<std::vector<int>> seams[2];
+
+    bool forward() const { return kernelX == nullptr || kernelY == nullptr; }
+    long long carve_direction(VideoFrame &frame, int count, bool horizontal, bool keyframe);
+};
+
+struct VideoOptions {
+    // 目标尺寸，<= 0 表示该方向不变；只能缩小
+    int width = 0;
+    int height = 0;
+    const Kernel *kernelX = nullptr;
+    const Kernel *kernelY = nullptr;
+    WindowEnergy window = WindowEnergy::None;
+    int band = 8;
+    int keyframe_interval = 0;
+    // 解码与编码队列中最多缓存的帧数
+    int queue_frames = 4;
+};
+
+struct VideoStats {
+    int frames = 0;
+    int width = 0;
+    int height = 0;
+    long long removed_energy = 0;
+    // 各阶段线程实际工作的时间
+    double decode_seconds = 0;
+    double carve_seconds = 0;
+    double encode_seconds = 0;
+};
+
+// 读取 Y4M（YUV4MPEG2）视频并写出缩小后的 Y4M，支持 4:2:0、4:4:4 与 mono
+// 解码、carve、编码分别在三个线程上流水线执行；input 与 output 可以是打开的 stdin/stdout
+// 失败时返回 false，原因写入 error
+bool carve_video(
+    QFile &input, QFile &output, const VideoOptions &options,
+    VideoStats *stats = nullptr, QString *error = nullptr
+);
+
+#endif // VIDEO_CARVER_H
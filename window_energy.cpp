@@ -0,0 +1,260 @@
+#include "window_energy.h"
+#include "seam_carver.h"
+#include "worker_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+// HoG：8 个方向格（无符号方向，[0, π)），11x11 窗口
+static const int hog_bins = 8;
+static const int hog_radius = 5;
+// e1 / max(HoG) 不超过 1（像素自身的幅值也计入它所在的格），放大为整数能量
+static const int hog_scale = 1024;
+// Entropy：灰度量化为 16 级，9x9 窗口
+static const int entropy_bins = 16;
+static const int entropy_radius = 4;
+// 熵（比特，16 级时至多为 4）的权重，与 e1 的范围（0 ~ 1020）相当
+static const int entropy_scale = 64;
+// 整幅计算时每个线程至少处理的像素数
+static const int window_grain_pixels = 64 * 1024;
+// 方向格的边界 22.5° 与 67.5° 的正切
+static const double tan_22_5 = 0.41421356237309503;
+static const double tan_67_5 = 2.4142135623730949;
+
+int window_energy_radius(WindowEnergy type) {
+    switch (type) {
+    case WindowEnergy::HoG: return hog_radius;
+    case WindowEnergy::Entropy: return entropy_radius;
+    default: return 0;
+    }
+}
+
+// (x, y) 处的 Sobel 梯度，越界的行和列取边界上的值，(|gx| + |gy|) / 2 与 Sobel 卷积能量一致
+static inline void sobel_at(const Plane<uchar> &gray, int x, int y, int &gx, int &gy) {
+    const uchar *above = gray.row(qMax(0, y - 1));
+    const uchar *line = gray.row(y);
+    const uchar *below = gray.row(qMin(gray.height() - 1, y + 1));
+    const int left = qMax(0, x - 1);
+    const int right = qMin(gray.width() - 1, x + 1);
+    gx = (above[right] - above[left]) + 2 * (line[right] - line[left]) + (below[right] - below[left]);
+    gy = (below[left] - above[left]) + 2 * (below[x] - above[x]) + (below[right] - above[right]);
+}
+
+static inline int sobel_e1(const Plane<uchar> &gray, int x, int y) {
+    int gx;
+    int gy;
+    sobel_at(gray, x, y, gx, gy);
+    return (qAbs(gx) + qAbs(gy)) / 2;
+}
+
+// 每种能量提供：像素在直方图中的格与权重 feature()，由窗口直方图与像素数得到能量 energy()
+struct HogWindow {
+    static const int bins = hog_bins;
+    static const int radius = hog_radius;
+
+    static inline void feature(const Plane<uchar> &gray, int x, int y, int &bin, int &weight) {
+        int gx;
+        int gy;
+        sobel_at(gray, x, y, gx, gy);
+        weight = (qAbs(gx) + qAbs(gy)) / 2;
+        if (weight == 0) {
+            bin = 0;
+            return;
+        }
+        // 方向取 [0, π)，翻到上半平面后由与三条边界的比较得到格，不调用 atan2
+        if (gy < 0 || (gy == 0 && gx < 0)) {
+            gx = -gx;
+            gy = -gy;
+        }
+        // 恰好 45° 与 135° 时归入角度较大的一格
+        const int ax = qAbs(gx);
+        if (gx > 0) {
+            bin = (gy > ax * tan_22_5) + (gy >= ax) + (gy > ax * tan_67_5);
+        } else {
+            bin = bins - 1 - (gy > ax * tan_22_5) - (gy > ax) - (gy > ax * tan_67_5);
+        }
+    }
+
+    static inline int energy(const Plane<uchar> &gray, int x, int y, const int *hist, int) {
+        const int e1 = sobel_e1(gray, x, y);
+        const int peak = *std::max_element(hist, hist + bins);
+        return e1 == 0 ? 0 : (int) ((long long) e1 * hog_scale / qMax(1, peak));
+    }
+};
+
+struct EntropyWindow {
+    static const int bins = entropy_bins;
+    static const int radius = entropy_radius;
+
+    static std::vector<double> log_table(bool times_c) {
+        std::vector<double> table((2 * radius + 1) * (2 * radius + 1) + 1, 0.0);
+        for (int c = 1; c < (int) table.size(); c++) {
+            table[c] = (times_c ? c : 1) * std::log2((double) c);
+        }
+        return table;
+    }
+
+    static inline void feature(const Plane<uchar> &gray, int x, int y, int &bin, int &weight) {
+        bin = gray.at(x, y) >> 4;
+        weight = 1;
+    }
+
+    static inline int energy(const Plane<uchar> &gray, int x, int y, const int *hist, int count) {
+        // log2(c) 与 c * log2(c)，c 不超过窗口的像素数
+        static const std::vector<double> logs = log_table(false);
+        static const std::vector<double> clogs = log_table(true);
+        double sum = 0;
+        for (int b = 0; b < bins; b++) {
+            sum += clogs[hist[b]];
+        }
+        const double entropy = logs[count] - sum / count;
+        return sobel_e1(gray, x, y) + (int) std::lround(entropy * entropy_scale);
+    }
+};
+
+// 处理第 i0 ~ i1 - 1 条线；columns 保存当前线的各列直方图，连续的两条线之间逐列滑动
+template <typename Window>
+static void window_lines(
+    const Plane<uchar> &gray, Plane<int> &output,
+    const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal, int i0, int i1
+) {
+    const int bins = Window::bins;
+    const int radius = Window::radius;
+    const int lines = horizontal ? gray.width() : gray.height();
+    const int n = horizontal ? gray.height() : gray.width();
+    std::vector<int> columns((std::size_t) n * bins, 0);
+    int hist[bins];
+    // columns 中 [valid_lo, valid_hi] 为第 valid_line 条线的列直方图
+    int valid_line = -1;
+    int valid_lo = 0;
+    int valid_hi = -1;
+
+    auto add = [&](int *h, int i, int p, int sign) {
+        int bin;
+        int weight;
+        Window::feature(gray, horizontal ? i : p, horizontal ? p : i, bin, weight);
+        h[bin] += sign * weight;
+    };
+    auto add_column = [&](int p, int sign) {
+        const int *c = columns.data() + (std::size_t) p * bins;
+        for (int b = 0; b < bins; b++) {
+            hist[b] += sign * c[b];
+        }
+    };
+
+    for (int i = i0; i < i1; i++) {
+        const int p0 = qMax(0, lo[i]);
+        const int p1 = qMin(n - 1, hi[i]);
+        if (p0 > p1) {
+            continue;
+        }
+        const int l0 = qMax(0, i - radius);
+        const int l1 = qMin(lines - 1, i + radius);
+        const int a = qMax(0, p0 - radius);
+        const int b = qMin(n - 1, p1 + radius);
+        const bool slide = valid_line == i - 1;
+        for (int p = a; p <= b; p++) {
+            int *c = columns.data() + (std::size_t) p * bins;
+            if (slide && p >= valid_lo && p <= valid_hi) {
+                if (i - radius - 1 >= 0) {
+                    add(c, i - radius - 1, p, -1);
+                }
+                if (i + radius < lines) {
+                    add(c, i + radius, p, 1);
+                }
+            } else {
+                std::fill(c, c + bins, 0);
+                for (int l = l0; l <= l1; l++) {
+                    add(c, l, p, 1);
+                }
+            }
+        }
+        valid_line = i;
+        valid_lo = a;
+        valid_hi = b;
+
+        std::fill(hist, hist + bins, 0);
+        for (int p = a; p <= qMin(n - 1, p0 + radius); p++) {
+            add_column(p, 1);
+        }
+        for (int p = p0; p <= p1; p++) {
+            const int x = horizontal ? i : p;
+            const int y = horizontal ? p : i;
+            const int count = (l1 - l0 + 1) * (qMin(n - 1, p + radius) - qMax(0, p - radius) + 1);
+            output.at(x, y) = Window::energy(gray, x, y, hist, count);
+            if (p == p1) {
+                break;
+            }
+            if (p + radius + 1 < n) {
+                add_column(p + radius + 1, 1);
+            }
+            if (p - radius >= 0) {
+                add_column(p - radius, -1);
+            }
+        }
+    }
+}
+
+static void window_lines(
+    const Plane<uchar> &gray, Plane<int> &output, WindowEnergy type,
+    const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal, int i0, int i1
+) {
+    if (type == WindowEnergy::HoG) {
+        window_lines<HogWindow>(gray, output, lo, hi, horizontal, i0, i1);
+    } else if (type == WindowEnergy::Entropy) {
+        window_lines<EntropyWindow>(gray, output, lo, hi, horizontal, i0, i1);
+    }
+}
+
+void calc_energy_window(const Plane<uchar> &gray, Plane<int> &output, WindowEnergy type) {
+    SEAM_CARVER_TRACE_PIXELS("calc_energy_window", (long long) gray.width() * gray.height());
+    output.resize(gray.width(), gray.height());
+    const std::vector<int> lo(gray.height(), 0);
+    const std::vector<int> hi(gray.height(), gray.width() - 1);
+    // 每块的第一条线需要从头统计列直方图，每块至少覆盖一个窗口的高度
+    const int grain = qMax(2 * window_energy_radius(type) + 1, window_grain_pixels / qMax(1, gray.width()));
+    WorkerPool::global().parallel_for(0, gray.height(), grain, [&](int y0, int y1) {
+        window_lines(gray, output, type, lo, hi, false, y0, y1);
+    });
+}
+
+void calc_energy_window_lines(
+    const Plane<uchar> &gray, Plane<int> &output, WindowEnergy type,
+    const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal
+) {
+    window_lines(gray, output, type, lo, hi, horizontal, 0, (int) lo.size());
+}
+
+// seam 移除后位于 q = p - j；梯度在第 r 条线的 [min(q) - 1, max(q)] 内改变（min/max 取自第 r - 1 ~ r + 1 条线），
+// 窗口与这一范围相交、或跨过 q 的像素都要重算，即第 i 条线的 [min(q) - 1 - radius, max(q) + radius]，
+// min/max 取自第 i - radius - 1 ~ i + radius + 1 条线；其余像素的窗口内容只是随 seam 一起平移
+// k 条 seam 时每条线取各 seam 范围的包络，近似模式一次移除多条 seam，接近整幅重算
+void update_energy_window_band(
+    const Plane<uchar> &gray, Plane<int> &energy, WindowEnergy type,
+    const std::vector<int> &positions, int k, bool horizontal
+) {
+    const int radius = window_energy_radius(type);
+    const int lines = horizontal ? gray.width() : gray.height();
+    const int n = horizontal ? gray.height() : gray.width();
+    // positions 在每条线内升序，移除后的位置 q 也不减
+    std::vector<int> q_min(lines);
+    std::vector<int> q_max(lines);
+    for (int r = 0; r < lines; r++) {
+        q_min[r] = positions[(std::size_t) r * k];
+        q_max[r] = positions[(std::size_t) r * k + k - 1] - (k - 1);
+    }
+    std::vector<int> lo(lines);
+    std::vector<int> hi(lines);
+    for (int i = 0; i < lines; i++) {
+        int q0 = n;
+        int q1 = -1;
+        for (int r = qMax(0, i - radius - 1); r <= qMin(lines - 1, i + radius + 1); r++) {
+            q0 = qMin(q0, q_min[r]);
+            q1 = qMax(q1, q_max[r]);
+        }
+        lo[i] = qMax(0, q0 - 1 - radius);
+        hi[i] = qMin(n - 1, q1 + radius);
+    }
+    window_lines(gray, energy, type, lo, hi, horizontal, 0, lines);
+}
@@ -0,0 +1,38 @@
+#ifndef WINDOW_ENERGY_H
+#define WINDOW_ENERGY_H
+
+#include "image_plane.h"
+
+#include <vector>
+
+typedef int Kernel[3][3];
+
+// 带邻域窗口统计的能量（Avidan 与 Shamir）
+// 两者都以 Sobel 梯度 e1 = (|gx| + |gy|) / 2 为基础：
+// HoG 为 e1 / max(HoG)，HoG 是 11x11 窗口内按梯度幅值加权的 8 方向直方图，条纹等重复纹理的能量被压低；
+// Entropy 为 e1 加上 9x9 窗口内灰度（16 级）的熵
+// 窗口直方图由逐列直方图沿线滑动得到：换行时每列加入一个像素、移出一个像素，
+// 沿线移动时加入一列、移出一列，每像素的代价只与直方图的格数有关，与窗口大小无关
+// 能量算子中卷积核之外的部分，由 find_kernels 按名称给出，与卷积核一起传给计算能量的函数；None 时只用卷积核
+enum class WindowEnergy { None, HoG, Entropy };
+
+// 窗口半径，窗口为 (2 * radius + 1) 的正方形，在图像边界处截断
+int window_energy_radius(WindowEnergy type);
+
+// 在灰度图上计算整幅窗口能量
+void calc_energy_window(const Plane<uchar> &gray, Plane<int> &output, WindowEnergy type);
+
+// 只重新计算第 i 条线上 [lo[i], hi[i]] 范围内的窗口能量，lo[i] > hi[i] 的线跳过
+// 竖直方向的线是行、位置是 x，horizontal 为 true 时线是列、位置是 y；lo 与 hi 的长度为线的条数
+void calc_energy_window_lines(
+    const Plane<uchar> &gray, Plane<int> &output, WindowEnergy type,
+    const std::vector<int> &lo, const std::vector<int> &hi, bool horizontal = false
+);
+
+// 移除 k 条 seam 后只重新计算窗口内容改变了的像素，参数与 update_energy_band 相同
+void update_energy_window_band(
+    const Plane<uchar> &gray, Plane<int> &energy, WindowEnergy type,
+    const std::vector<int> &positions, int k, bool horizontal
+);
+
+#endif // WINDOW_ENERGY_H
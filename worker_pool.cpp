@@ -0,0 +1,114 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// 空闲线程在休眠前轮询新任务的次数
+static const int spin_iterations = 4096;
+
+static inline void spin_pause(int iteration) {
+    if (iteration > 64) {
+        std::this_thread::yield();
+    }
+}
+
+WorkerPool::WorkerPool(int n_threads) {
+    if (n_threads <= 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 1; i < n_threads; i++) {
+        threads.emplace_back(&WorkerPool::worker_loop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+int WorkerPool::size() const {
+    return (int) threads.size() + 1;
+}
+
+void WorkerPool::run(int max_workers, const std::function<void(int, int)> &task) {
+    std::unique_lock<std::mutex> busy_lock(busy, std::try_to_lock);
+    const int n = std::min(max_workers, size());
+    if (!busy_lock.owns_lock() || n <= 1) {
+        task(0, 1);
+        return;
+    }
+
+    this->task = &task;
+    count = n;
+    remaining.store((int) threads.size(), std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    wake.notify_all();
+
+    task(0, n);
+    for (int i = 0; remaining.load(std::memory_order_acquire) != 0; i++) {
+        spin_pause(i);
+    }
+}
+
+void WorkerPool::parallel_for(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+    const int total = end - begin;
+    if (total <= 0) {
+        return;
+    }
+    const int chunks = std::max(1, std::min(size(), total / std::max(1, grain)));
+    run(chunks, [&](int index, int count) {
+        const int b = begin + (int) ((long long) total * index / count);
+        const int e = begin + (int) ((long long) total * (index + 1) / count);
+        if (b < e) {
+            body(b, e);
+        }
+    });
+}
+
+WorkerPool &WorkerPool::global() {
+    // 环境变量 SEAM_CARVER_THREADS 可以限制线程数
+    static WorkerPool pool(std::getenv("SEAM_CARVER_THREADS") ? std::atoi(std::getenv("SEAM_CARVER_THREADS")) : 0);
+    return pool;
+}
+
+void WorkerPool::worker_loop(int index) {
+    std::uint64_t seen = 0;
+    for (;;) {
+        for (int i = 0; i < spin_iterations && generation.load(std::memory_order_acquire) == seen && !stop; i++) {
+            spin_pause(i);
+        }
+        if (generation.load(std::memory_order_acquire) == seen) {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stop || generation.load(std::memory_order_acquire) != seen; });
+        }
+        if (stop) {
+            return;
+        }
+        seen = generation.load(std::memory_order_acquire);
+        if (index < count) {
+            (*task)(index, count);
+        }
+        remaining.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void SpinBarrier::wait(int count) {
+    const unsigned current = phase.load(std::memory_order_acquire);
+    if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+        arrived.store(0, std::memory_order_relaxed);
+        phase.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    for (int i = 0; phase.load(std::memory_order_acquire) == current; i++) {
+        spin_pause(i);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 常驻线程池，线程在两次任务之间先自旋一段时间再休眠，
+// 使逐条 seam、逐行的并行调度不需要反复创建线程
+class WorkerPool
+{
+public:
+    // n_threads 包含调用线程，<= 0 时取 CPU 核数
+    explicit WorkerPool(int n_threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int size() const;
+
+    // 在至多 max_workers 个线程上同时执行 task(index, count)，调用线程执行 index 0，
+    // 全部完成后返回。线程池正被其他调用者使用时只在调用线程上执行 task(0, 1)
+    void run(int max_workers, const std::function<void(int, int)> &task);
+
+    // 把 [begin, end) 按每块至少 grain 个元素分给各线程执行 body(b, e)
+    void parallel_for(int begin, int end, int grain, const std::function<void(int, int)> &body);
+
+    // 进程内共享的线程池，线程数可由环境变量 SEAM_CARVER_THREADS 指定
+    static WorkerPool &global();
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex busy;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<std::uint64_t> generation{0};
+    std::atomic<int> remaining{0};
+    std::atomic<bool> stop{false};
+    const std::function<void(int, int)> *task = nullptr;
+    int count = 0;
+
+    void worker_loop(int index);
+};
+
+// 自旋栅栏，用于 run 的任务内部逐行同步；count 为本次 run 的线程数
+class SpinBarrier
+{
+public:
+    void wait(int count);
+
+private:
+    std::atomic<int> arrived{0};
+    std::atomic<unsigned> phase{0};
+};
+
+#endif // WORKER_POOL_H